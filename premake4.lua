@@ -37,7 +37,7 @@ solution 'hibiscus'
             includedirs(path)
         end
         linkoptions(io.popen('pkg-config --cflags --libs gstreamermm-1.0'):read('*all'))
-        links {'glfw', 'dl', 'pthread', 'udev', 'atomic'}
+        links {'glfw', 'dl', 'pthread', 'v4l2', 'jpeg', 'udev', 'atomic'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -50,7 +50,12 @@ solution 'hibiscus'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/teensy.hpp', 'source/monitor_teensy.cpp'}
+        files {
+            'source/latency_histogram.hpp',
+            'source/reactor.hpp',
+            'source/spsc_queue.hpp',
+            'source/teensy.hpp',
+            'source/monitor_teensy.cpp'}
         buildoptions {'-std=c++11'}
         linkoptions {'-std=c++11'}
         links {'pthread', 'ncursesw'}
@@ -62,6 +67,121 @@ solution 'hibiscus'
             targetdir 'build/debug'
             defines {'DEBUG'}
             flags {'Symbols'}
+    project 'emulate_teensy'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/emulate_teensy.cpp'}
+        buildoptions {'-std=c++11'}
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+    project 'replay_teensy'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/replay_teensy.cpp'}
+        buildoptions {'-std=c++11'}
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+    project 'test_teensy_allocations'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/test_teensy_allocations.cpp'}
+        buildoptions {'-std=c++11'}
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+    project 'test_teensy_record'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/test_teensy_record.cpp'}
+        buildoptions {'-std=c++11'}
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+    project 'test_livetrack_report'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/test_livetrack_report.cpp'}
+        buildoptions {'-std=c++11'}
+        if io.popen('uname -m'):read('*l') == 'x86_64' then
+            buildoptions {'-mssse3'}
+        end
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+    project 'benchmark_tty'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/benchmark_tty.cpp'}
+        buildoptions {'-std=c++11'}
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+    project 'benchmark_teensy_record'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/benchmark_teensy_record.cpp'}
+        buildoptions {'-std=c++11'}
+        linkoptions {'-std=c++11'}
+        links {'pthread'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
     project 'draw'
         kind 'ConsoleApp'
         language 'C++'
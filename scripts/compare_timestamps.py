@@ -0,0 +1,75 @@
+import argparse
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+# relative path to the programs
+programs_directory = os.path.join(os.path.dirname(os.path.dirname(os.path.realpath(__file__))), 'build', 'release')
+
+# parse the arguments
+parser = argparse.ArgumentParser(
+    description='Compare the DMD timestamps decoded from 32-bit and 64-bit Teensy streams across a micros() overflow')
+parser.add_argument('-t', '--start-t', type=int, default=4294000000, help='initial value of the emulated micros()')
+parser.add_argument('-d', '--duration', type=float, default=3.0, help='recording duration in seconds')
+parser.add_argument('-k', '--keep', help='keep the recorded logs in the given directory')
+parser.add_argument('-p', '--programs', default=programs_directory, help='directory of the compiled programs')
+arguments = parser.parse_args()
+programs_directory = arguments.programs
+directory = arguments.keep if arguments.keep is not None else tempfile.mkdtemp()
+if not os.path.isdir(directory):
+    os.makedirs(directory)
+
+# record both streams with emulate_teensy, replay_teensy acting as the host
+logs = {}
+for name, flags in (('extended', []), ('legacy', ['--no-extended-timestamps'])):
+    logs[name] = os.path.join(directory, name + '.log')
+    link = os.path.join(directory, 'teensy')
+    emulator = subprocess.Popen(
+        [os.path.join(programs_directory, 'emulate_teensy'),
+         '--start-t', str(arguments.start_t),
+         '--buttons', '0',
+         '--link', link,
+         '--output', logs[name]] + flags,
+        stdout=subprocess.DEVNULL)
+    time.sleep(0.5)
+    subprocess.check_call(
+        [os.path.join(programs_directory, 'replay_teensy'), '--duration', str(arguments.duration), link],
+        stdout=subprocess.DEVNULL)
+    emulator.send_signal(signal.SIGINT)
+    emulator.wait()
+
+# decode the logs and keep the DMD events
+timestamps = {}
+for name, log in logs.items():
+    output = subprocess.check_output(
+        [os.path.join(programs_directory, 'replay_teensy'), '--events', log], stderr=subprocess.DEVNULL)
+    timestamps[name] = []
+    for line in output.decode().splitlines():
+        t, event_type = line.split(' ')
+        # the recordings start at different points of the frame, hence the first 'd' event aligns them
+        if event_type == 'd' or (event_type == 'e' and len(timestamps[name]) > 0):
+            timestamps[name].append(int(t))
+
+# the streams were recorded one after the other, hence their DMD timestamps differ by a constant offset
+overflow = 1 << 32
+errors = []
+for name, values in timestamps.items():
+    if len(values) == 0 or values[0] >= overflow or values[-1] < overflow:
+        errors.append('the ' + name + ' stream does not cross 2^32 (' + str(len(values)) + ' DMD events)')
+if len(errors) == 0:
+    offset = timestamps['legacy'][0] - timestamps['extended'][0]
+    pairs = list(zip(timestamps['extended'], timestamps['legacy']))
+    mismatches = [(extended, legacy) for extended, legacy in pairs if legacy - extended != offset]
+    crossing = sum(1 for extended, legacy in pairs if extended >= overflow)
+    print(str(len(pairs)) + ' DMD events compared (' + str(crossing) + ' after 2^32), offset '
+          + str(offset) + ' us, ' + str(len(mismatches)) + ' mismatches')
+    for extended, legacy in mismatches[:8]:
+        print('    extended ' + str(extended) + ', legacy ' + str(legacy))
+    if len(mismatches) > 0:
+        errors.append('the 32-bit and 64-bit decoders disagree')
+for error in errors:
+    print(error)
+sys.exit(1 if len(errors) > 0 else 0)
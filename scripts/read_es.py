@@ -16,6 +16,19 @@ for index in range(0, len(events['t'])):
     type = chr(events['bytes'][index][0])
     if type == 's' or type == 'f':
         print('{} {} index: {}'.format(events['t'][index], type, struct.unpack('<L', events['bytes'][index][1:])[0]))
+    elif type == 'g':
+        payload = events['bytes'][index][1:]
+        frame_index = struct.unpack('<L', payload[0:4])[0]
+        # each pair of bytes is the delay between a subframe and the first one
+        delays = [struct.unpack('<H', payload[offset:offset + 2])[0] for offset in range(4, len(payload) - 1, 2)]
+        intervals = [delay - previous_delay for previous_delay, delay in zip([0] + delays[:-1], delays)]
+        print('{} {} index: {}, subframes: {}, subframe ts: [{}], intervals: [{}]'.format(
+            events['t'][index],
+            type,
+            frame_index,
+            len(delays) + 1,
+            ', '.join(str(events['t'][index] + delay) for delay in [0] + delays),
+            ', '.join(str(interval) for interval in intervals)))
     elif type == 'a' or type == 'b':
         x, y, major_axis, minor_axis = struct.unpack('<ddLL', events['bytes'][index][1:])
         print('{} {} position: ({}, {}), pupil: ({}, {})'.format(
@@ -28,6 +41,20 @@ for index in range(0, len(events['t'])):
     elif type == 'c':
         t, u = struct.unpack('<QQ', events['bytes'][index][1:])
         print('{} {} t: {}, u: {}'.format(events['t'][index], type, t, u))
+    elif type == 'F' or type == 'S' or type == 'B':
+        eye, begin_t, end_t, begin_x, begin_y, end_x, end_y, peak_velocity = struct.unpack(
+            '<BQQddddd', events['bytes'][index][1:])
+        print('{} {} eye: {}, from {} at ({}, {}) to {} at ({}, {}), peak velocity: {}'.format(
+            events['t'][index],
+            type,
+            'left' if eye == 0 else 'right',
+            begin_t,
+            begin_x,
+            begin_y,
+            end_t,
+            end_x,
+            end_y,
+            peak_velocity))
     elif type == 'w':
         print('{} {} {}'.format(events['t'][index], type, events['bytes'][index][1:].decode('ascii')))
     else:
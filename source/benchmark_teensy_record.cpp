@@ -0,0 +1,186 @@
+#include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
+#include "teensy.hpp"
+#include <fstream>
+#include <iostream>
+
+/// benchmark_record_delegate skips the handshake of teensy_record_delegate, which requires a tty.
+template <typename HandleEvent>
+class benchmark_record_delegate : public hibiscus::teensy_record_delegate<HandleEvent> {
+    public:
+    benchmark_record_delegate(HandleEvent handle_event, hibiscus::teensy_dmd_mode dmd_mode, bool extended_timestamps) :
+        hibiscus::teensy_record_delegate<HandleEvent>(std::forward<HandleEvent>(handle_event), dmd_mode, nullptr) {
+        this->_extended_timestamps = extended_timestamps;
+    }
+};
+
+/// make_benchmark_record_delegate creates a benchmark delegate from a functor.
+template <typename HandleEvent>
+benchmark_record_delegate<HandleEvent>
+make_benchmark_record_delegate(HandleEvent handle_event, hibiscus::teensy_dmd_mode dmd_mode, bool extended_timestamps) {
+    return benchmark_record_delegate<HandleEvent>(
+        std::forward<HandleEvent>(handle_event), dmd_mode, extended_timestamps);
+}
+
+/// log_to_messages unescapes the messages following the reset reply.
+/// The 'a' and 'b' acknowledgements are skipped, since they require a teensy parent.
+std::vector<hibiscus::teensy_message> log_to_messages(const std::vector<uint8_t>& log, bool& extended_timestamps) {
+    std::vector<hibiscus::teensy_message> messages;
+    hibiscus::teensy_message message;
+    message.size = 0;
+    auto reset = false;
+    auto reading = false;
+    auto escaped = false;
+    auto push = [&](uint8_t byte) {
+        if (message.size < message.bytes.size()) {
+            message.bytes[message.size] = byte;
+            ++message.size;
+        } else {
+            reading = false;
+        }
+    };
+    extended_timestamps = false;
+    for (auto byte : log) {
+        if (reading) {
+            if (escaped) {
+                escaped = false;
+                switch (byte) {
+                    case 0xab:
+                        push(0x00);
+                        break;
+                    case 0xac:
+                        push(0xaa);
+                        break;
+                    case 0xad:
+                        push(0xff);
+                        break;
+                    default:
+                        reading = false;
+                }
+            } else {
+                switch (byte) {
+                    case 0x00:
+                        message.size = 0;
+                        break;
+                    case 0xaa:
+                        escaped = true;
+                        break;
+                    case 0xff:
+                        reading = false;
+                        if (message.size == 1 && message.type() == 'r') {
+                            reset = true;
+                        } else if (reset) {
+                            if (message.size == 1 && message.type() == 'x') {
+                                extended_timestamps = true;
+                            } else if (message.size > 0 && message.type() != 'a' && message.type() != 'b') {
+                                messages.push_back(message);
+                            }
+                        }
+                        break;
+                    default:
+                        push(byte);
+                        break;
+                }
+            }
+        } else if (byte == 0x00) {
+            reading = true;
+            escaped = false;
+            message.size = 0;
+        }
+    }
+    if (!reset) {
+        throw std::runtime_error("the log does not contain a reset reply");
+    }
+    return messages;
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "benchmark_teensy_record decodes the messages of a Teensy byte log with teensy_record_delegate,",
+            "and checks that the delegate (timestamps correction and reordering) runs at least 10 times faster",
+            "than real time",
+            "Syntax: ./benchmark_teensy_record [options] /path/to/log",
+            "The log is written by emulate_teensy --output. It is unescaped before the measurement,",
+            "so that only the delegate is timed.",
+            "Available options:",
+            "    -m [mode], --dmd-mode [mode]          sets the DMD protocol, one of:",
+            "                                              subframes, expanded or compact",
+            "                                              defaults to subframes",
+            "    -h, --help                            shows this help message",
+        },
+        argc,
+        argv,
+        1,
+        {{"dmd-mode", {"m"}}},
+        {},
+        [](pontella::command command) {
+            auto dmd_mode = hibiscus::teensy_dmd_mode::subframes;
+            {
+                const auto name_and_value = command.options.find("dmd-mode");
+                if (name_and_value != command.options.end()) {
+                    if (name_and_value->second == "expanded") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::expanded_frames;
+                    } else if (name_and_value->second == "compact") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::compact_frames;
+                    } else if (name_and_value->second != "subframes") {
+                        throw std::runtime_error("the DMD mode must be 'subframes', 'expanded' or 'compact'");
+                    }
+                }
+            }
+            std::vector<uint8_t> log;
+            {
+                std::ifstream input(command.arguments.front(), std::ifstream::binary);
+                if (!input.good()) {
+                    throw std::runtime_error(
+                        std::string("'") + command.arguments.front() + "' could not be open for reading");
+                }
+                log.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+            }
+            auto extended_timestamps = false;
+            const auto messages = log_to_messages(log, extended_timestamps);
+
+            // the log is decoded several times, each round with a new delegate
+            uint64_t events = 0;
+            uint64_t first_t = std::numeric_limits<uint64_t>::max();
+            uint64_t last_t = 0;
+            uint64_t checksum = 0;
+            std::size_t rounds = 0;
+            std::chrono::steady_clock::duration duration(0);
+            while (rounds < 4 || duration < std::chrono::seconds(1)) {
+                auto delegate = make_benchmark_record_delegate(
+                    [&](hibiscus::teensy_event teensy_event) {
+                        ++events;
+                        checksum += teensy_event.t;
+                        // ticks ('c') carry a frame index instead of a timestamp
+                        if (rounds == 0 && teensy_event.type != 'c') {
+                            first_t = std::min(first_t, teensy_event.t);
+                            last_t = std::max(last_t, teensy_event.t);
+                        }
+                    },
+                    dmd_mode,
+                    extended_timestamps);
+                const auto begin = std::chrono::steady_clock::now();
+                for (const auto& message : messages) {
+                    delegate.handle_message(nullptr, message);
+                }
+                duration += std::chrono::steady_clock::now() - begin;
+                ++rounds;
+            }
+            if (last_t <= first_t) {
+                throw std::runtime_error("the log does not span a Teensy duration");
+            }
+            const auto teensy_duration = static_cast<double>(last_t - first_t) / 1e6;
+            const auto wall_duration =
+                std::chrono::duration_cast<std::chrono::duration<double>>(duration).count() / rounds;
+            const auto real_time_factor = teensy_duration / wall_duration;
+            std::cout << messages.size() << " messages and " << events / rounds << " events ("
+                      << (extended_timestamps ? "64" : "32") << "-bit timestamps) spanning " << teensy_duration
+                      << " s of Teensy time, decoded in " << wall_duration * 1e3 << " ms (" << rounds
+                      << " rounds, checksum " << checksum << ")" << std::endl;
+            std::cout << wall_duration / (static_cast<double>(events) / rounds) * 1e9 << " ns per event, "
+                      << real_time_factor << " times real time" << std::endl;
+            if (real_time_factor < 10) {
+                throw std::runtime_error("the delegate runs less than 10 times faster than real time");
+            }
+        });
+}
@@ -0,0 +1,141 @@
+#include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
+#include "pty_teensy.hpp"
+#include "teensy.hpp"
+#include <fstream>
+#include <iostream>
+
+/// read_mode selects the tty read path measured by the benchmark.
+enum class read_mode {
+    byte,
+    block,
+};
+
+/// read_statistics summarizes a playback.
+struct read_statistics {
+    std::size_t bytes;
+    std::size_t messages;
+    std::size_t system_calls;
+    double duration;
+};
+
+/// measure plays back a log through a pseudo-terminal and reads it with the given mode.
+/// The byte mode issues one read system call per byte, like tty::read did before blocks were introduced,
+/// whereas the block mode calls tty::read_block, which issues a poll and a read per block.
+read_statistics measure(const std::vector<uint8_t>& log, std::size_t expected_bytes, read_mode mode) {
+    std::atomic_bool running(true);
+    std::exception_ptr playback_exception;
+    hibiscus::pty_teensy emulated_teensy;
+    std::thread playback_loop([&]() {
+        try {
+            emulated_teensy.replay(log, running);
+        } catch (...) {
+            playback_exception = std::current_exception();
+        }
+    });
+    read_statistics statistics{0, 0, 0, 0.0};
+    try {
+        // the timeout (1 s) covers the delay of logs recorded without extended timestamps
+        hibiscus::tty tty(emulated_teensy.filename(), B9600, 10);
+        const std::array<uint8_t, 3> reset{{0x00, 'r', 0xff}};
+        tty.write(reset.data(), reset.size());
+        for (std::size_t index = 0; index < reset.size(); ++index) {
+            tty.read();
+        }
+        const std::array<uint8_t, 3> extended_timestamps{{0x00, 'x', 0xff}};
+        tty.write(extended_timestamps.data(), extended_timestamps.size());
+        std::chrono::steady_clock::time_point begin;
+        switch (mode) {
+            case read_mode::byte: {
+                uint8_t byte;
+                while (statistics.bytes < expected_bytes) {
+                    ++statistics.system_calls;
+                    if (::read(tty.file_descriptor(), &byte, 1) <= 0) {
+                        throw std::runtime_error("read timeout");
+                    }
+                    if (statistics.bytes == 0) {
+                        begin = std::chrono::steady_clock::now();
+                    }
+                    ++statistics.bytes;
+                    if (byte == 0xff) {
+                        ++statistics.messages;
+                    }
+                }
+                break;
+            }
+            case read_mode::block: {
+                while (statistics.bytes < expected_bytes) {
+                    const auto bytes = tty.read_block();
+                    if (bytes.first == bytes.second) {
+                        ++statistics.system_calls;
+                        throw std::runtime_error("read timeout");
+                    }
+                    statistics.system_calls += 2;
+                    if (statistics.bytes == 0) {
+                        begin = std::chrono::steady_clock::now();
+                    }
+                    statistics.bytes += bytes.second - bytes.first;
+                    statistics.messages += std::count(bytes.first, bytes.second, 0xff);
+                }
+                break;
+            }
+        }
+        statistics.duration =
+            std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - begin).count();
+    } catch (...) {
+        running.store(false, std::memory_order_release);
+        playback_loop.join();
+        throw;
+    }
+    playback_loop.join();
+    if (playback_exception) {
+        std::rethrow_exception(playback_exception);
+    }
+    return statistics;
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "benchmark_tty plays back a Teensy byte log through a pseudo-terminal, and compares the tty read paths",
+            "(one system call per byte, and tty::read_block)",
+            "Syntax: ./benchmark_tty [options] /path/to/log",
+            "The log is written by emulate_teensy --output.",
+            "Available options:",
+            "    -h, --help                            shows this help message",
+        },
+        argc,
+        argv,
+        1,
+        {},
+        {},
+        [](pontella::command command) {
+            std::vector<uint8_t> log;
+            {
+                std::ifstream input(command.arguments.front(), std::ifstream::binary);
+                if (!input.good()) {
+                    throw std::runtime_error(
+                        std::string("'") + command.arguments.front() + "' could not be open for reading");
+                }
+                log.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+            }
+            // the playback starts with the reset reply, which is read during the handshake
+            std::size_t expected_bytes = 0;
+            for (std::size_t index = 0; index + 2 < log.size(); ++index) {
+                if (log[index] == 0x00 && log[index + 1] == 'r' && log[index + 2] == 0xff) {
+                    expected_bytes = log.size() - index - 3;
+                    break;
+                }
+            }
+            if (expected_bytes == 0) {
+                throw std::runtime_error("the log does not contain bytes after a reset reply");
+            }
+            for (auto mode : {read_mode::byte, read_mode::block}) {
+                const auto statistics = measure(log, expected_bytes, mode);
+                std::cout << (mode == read_mode::byte ? "byte reads: " : "block reads: ") << statistics.bytes
+                          << " bytes and " << statistics.messages << " messages in " << statistics.duration << " s, "
+                          << statistics.bytes / statistics.duration / 1e6 << " MB/s, "
+                          << static_cast<double>(statistics.system_calls) / statistics.messages
+                          << " system calls per message" << std::endl;
+            }
+        });
+}
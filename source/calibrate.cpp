@@ -5,12 +5,14 @@
 #include "../third_party/hummingbird/source/rotate.hpp"
 #include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
 #include "calibration.hpp"
-#include "livetrack_data_observable.hpp"
+#include "latency_histogram.hpp"
+#include "livetrack_replay_observable.hpp"
 #include "livetrack_video_observable.hpp"
 #include "terminal.hpp"
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/SVD>
 #include <fstream>
+#include <iostream>
 #include <random>
 
 /// calibration_optimization optimization the eye tracker calibration matrix.
@@ -286,164 +288,42 @@ std::pair<hibiscus::calibration, std::vector<uint8_t>> estimate_calibration_and_
     return calibration_and_gaze_map;
 }
 
-/// downsample converts a 1280 x 240 RGB frame to a 576 x 108 RGB frame.
+/// downsample converts the top 640 x 120 pixels of a 640 pixels wide grayscale frame
+/// to a 576 x 108 grayscale frame.
+/// Input pixels span 9 units and output pixels 10 units along each axis, hence each output pixel is the mean of
+/// the (at most) 2 x 2 input pixels it overlaps, weighted by the overlapping areas.
 inline void downsample(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) {
-    uint16_t x_offset = 0;
-    uint16_t x_input = 0;
-    std::array<uint8_t, 4> x_areas{9, 9, 2, 1};
-    uint8_t x_range = 3;
-    uint16_t y_offset = 0;
-    uint16_t y_input = 0;
-    std::array<uint8_t, 4> y_areas{9, 9, 2, 1};
-    uint8_t y_range = 3;
     for (uint16_t y = 0; y < 108; ++y) {
+        const uint16_t y_input = y * 10 / 9;
+        const auto y_area = static_cast<uint32_t>(std::min(9 * (y_input + 1) - y * 10, 10));
+        const auto first_row = input.data() + y_input * 640;
+        const auto second_row = input.data() + std::min(y_input + 1, 119) * 640;
         for (uint16_t x = 0; x < 576; ++x) {
-            const auto x_reference = x_offset + x_input;
-            const auto y_reference = y_offset + y_input;
-            for (uint8_t channel = 0; channel < 3; ++channel) {
-                uint32_t sum = 0;
-                for (uint8_t y_index = 0; y_index < y_range; ++y_index) {
-                    for (uint8_t x_index = 0; x_index < x_range; ++x_index) {
-                        sum += input[((x_reference + x_index) + (y_reference + y_index) * 1280) * 3 + channel]
-                               * x_areas[x_index] * y_areas[y_index];
-                    }
-                }
-                output[(x + y * 576) * 3 + channel] = static_cast<uint8_t>(sum / 400);
-            }
-            switch (x_input) {
-                case 0:
-                    x_input = 2;
-                    x_areas[0] = 7;
-                    x_areas[1] = 9;
-                    x_areas[2] = 4;
-                    break;
-                case 2:
-                    x_input = 4;
-                    x_areas[0] = 5;
-                    x_areas[1] = 9;
-                    x_areas[2] = 6;
-                    break;
-                case 4:
-                    x_input = 6;
-                    x_areas[0] = 3;
-                    x_areas[1] = 9;
-                    x_areas[2] = 8;
-                    break;
-                case 6:
-                    x_input = 8;
-                    x_areas[0] = 1;
-                    x_areas[1] = 9;
-                    x_areas[2] = 9;
-                    x_range = 4;
-                    break;
-                case 8:
-                    x_input = 11;
-                    x_areas[0] = 8;
-                    x_areas[1] = 9;
-                    x_areas[2] = 3;
-                    x_range = 3;
-                    break;
-                case 11:
-                    x_input = 13;
-                    x_areas[0] = 6;
-                    x_areas[1] = 9;
-                    x_areas[2] = 5;
-                    break;
-                case 13:
-                    x_input = 15;
-                    x_areas[0] = 4;
-                    x_areas[1] = 9;
-                    x_areas[2] = 7;
-                    break;
-                case 15:
-                    x_input = 17;
-                    x_areas[0] = 2;
-                    x_areas[1] = 9;
-                    x_areas[2] = 9;
-                    break;
-                case 17:
-                    x_input = 0;
-                    x_areas[0] = 9;
-                    x_areas[1] = 9;
-                    x_areas[2] = 2;
-                    x_offset += 20;
-                    break;
-                default:
-                    break;
-            }
-        }
-        x_offset = 0;
-        switch (y_input) {
-            case 0:
-                y_input = 2;
-                y_areas[0] = 7;
-                y_areas[1] = 9;
-                y_areas[2] = 4;
-                break;
-            case 2:
-                y_input = 4;
-                y_areas[0] = 5;
-                y_areas[1] = 9;
-                y_areas[2] = 6;
-                break;
-            case 4:
-                y_input = 6;
-                y_areas[0] = 3;
-                y_areas[1] = 9;
-                y_areas[2] = 8;
-                break;
-            case 6:
-                y_input = 8;
-                y_areas[0] = 1;
-                y_areas[1] = 9;
-                y_areas[2] = 9;
-                y_range = 4;
-                break;
-            case 8:
-                y_input = 11;
-                y_areas[0] = 8;
-                y_areas[1] = 9;
-                y_areas[2] = 3;
-                y_range = 3;
-                break;
-            case 11:
-                y_input = 13;
-                y_areas[0] = 6;
-                y_areas[1] = 9;
-                y_areas[2] = 5;
-                break;
-            case 13:
-                y_input = 15;
-                y_areas[0] = 4;
-                y_areas[1] = 9;
-                y_areas[2] = 7;
-                break;
-            case 15:
-                y_input = 17;
-                y_areas[0] = 2;
-                y_areas[1] = 9;
-                y_areas[2] = 9;
-                break;
-            case 17:
-                y_input = 0;
-                y_areas[0] = 9;
-                y_areas[1] = 9;
-                y_areas[2] = 2;
-                y_offset += 20;
-                break;
-            default:
-                break;
+            const uint16_t x_input = x * 10 / 9;
+            const auto x_area = static_cast<uint32_t>(std::min(9 * (x_input + 1) - x * 10, 10));
+            const auto x_next = std::min(x_input + 1, 639);
+            const auto sum = (first_row[x_input] * x_area + first_row[x_next] * (10 - x_area)) * y_area
+                             + (second_row[x_input] * x_area + second_row[x_next] * (10 - x_area)) * (10 - y_area);
+            output[x + y * 576] = static_cast<uint8_t>(sum / 100);
         }
     }
 }
 
-/// rotate converts a 576 x 108 RGB frame to a 608 x 684 RGB frame.
+/// juxtapose places two 288 x 108 grayscale regions (stored one after the other) side by side
+/// in a 576 x 108 grayscale frame.
+inline void juxtapose(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) {
+    for (uint16_t y = 0; y < 108; ++y) {
+        std::copy_n(input.data() + y * 288, 288, output.data() + y * 576);
+        std::copy_n(input.data() + (108 + y) * 288, 288, output.data() + y * 576 + 288);
+    }
+}
+
+/// rotate converts a 576 x 108 grayscale frame to a 608 x 684 RGB frame.
 inline void rotate(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) {
     for (uint16_t y = 0; y < 108; ++y) {
         for (uint16_t x = 0; x < 576; ++x) {
             for (uint8_t channel = 0; channel < 3; ++channel) {
-                output[(133 + (x + y + 1) / 2 + (575 - x + y) * 608) * 3 + channel] =
-                    input[(x + y * 576) * 3 + channel];
+                output[(133 + (x + y + 1) / 2 + (575 - x + y) * 608) * 3 + channel] = input[x + y * 576];
             }
         }
     }
@@ -502,6 +382,30 @@ int main(int argc, char* argv[]) {
             "LightCrafter IP address",
             "                                                            "
             "defaults to 10.10.10.100",
+            "    -l [path], --livetrack-replay [path]                reads the "
+            "LiveTrack samples from a file",
+            "                                                            "
+            "instead of the eye tracker (raw reports or a dump.csv)",
+            "    -s [speed], --replay-speed [speed]                  sets the "
+            "replay speed",
+            "                                                            "
+            "0 replays as fast as possible, defaults to 1",
+            "    -w [path], --livetrack-log [path]                   writes the "
+            "raw LiveTrack reports to the given file",
+            "    -b [count], --video-buffers [count]                 sets the "
+            "number of LiveTrack video buffers",
+            "                                                            "
+            "0 copies each frame with read, defaults to 4",
+            "    -e [x,y,x,y], --eye-regions [x,y,x,y]               previews "
+            "the left and right eyes at full resolution",
+            "                                                            "
+            "the values are the top-left corners of two 288 x 108 regions",
+            "                                                            "
+            "in the 1280 x 280 LiveTrack frame",
+            "    -v [path], --livetrack-video [path]                 writes the "
+            "LiveTrack MJPEG frames to the given file",
+            "                                                            "
+            "and their capture times to path.index",
             "    -f, --force                                         overwrites "
             "the output file if it exists",
             "    -h, --help                                          shows this "
@@ -510,7 +414,14 @@ int main(int argc, char* argv[]) {
         argc,
         argv,
         -1,
-        {{"parameters", {"p"}}, {"ip", {"i"}}},
+        {{"parameters", {"p"}},
+         {"ip", {"i"}},
+         {"livetrack-replay", {"l"}},
+         {"replay-speed", {"s"}},
+         {"livetrack-log", {"w"}},
+         {"video-buffers", {"b"}},
+         {"eye-regions", {"e"}},
+         {"livetrack-video", {"v"}}},
         {{"force", {"f"}}},
         [](pontella::command command) {
             if (command.arguments.size() != 1 && command.arguments.size() != 2) {
@@ -705,6 +616,91 @@ int main(int argc, char* argv[]) {
                     ip = hummingbird::lightcrafter::parse_ip(name_and_value->second);
                 }
             }
+            std::string livetrack_replay_filename;
+            {
+                const auto name_and_value = command.options.find("livetrack-replay");
+                if (name_and_value != command.options.end()) {
+                    livetrack_replay_filename = name_and_value->second;
+                }
+            }
+            double replay_speed = 1.0;
+            {
+                const auto name_and_value = command.options.find("replay-speed");
+                if (name_and_value != command.options.end()) {
+                    replay_speed = std::stod(name_and_value->second);
+                }
+            }
+            std::size_t video_buffers = 4;
+            {
+                const auto name_and_value = command.options.find("video-buffers");
+                if (name_and_value != command.options.end()) {
+                    video_buffers = std::stoull(name_and_value->second);
+                }
+            }
+            // the preview uses the top 1280 x 240 pixels of the frames, decoded at half resolution in grayscale,
+            // or two full-resolution eye regions
+            hibiscus::livetrack_video_output livetrack_video_output;
+            livetrack_video_output.minimum_width = 576;
+            livetrack_video_output.minimum_height = 120;
+            livetrack_video_output.grayscale = true;
+            {
+                const auto name_and_value = command.options.find("eye-regions");
+                if (name_and_value != command.options.end()) {
+                    std::vector<uint16_t> corners;
+                    std::size_t begin = 0;
+                    for (;;) {
+                        const auto end = name_and_value->second.find(',', begin);
+                        corners.push_back(
+                            static_cast<uint16_t>(std::stoul(name_and_value->second.substr(begin, end - begin))));
+                        if (end == std::string::npos) {
+                            break;
+                        }
+                        begin = end + 1;
+                    }
+                    if (corners.size() != 4) {
+                        throw std::runtime_error("eye-regions must contain four comma-separated values");
+                    }
+                    for (std::size_t index = 0; index < 2; ++index) {
+                        hibiscus::livetrack_video_region region;
+                        region.x = corners[index * 2];
+                        region.y = corners[index * 2 + 1];
+                        region.width = 288;
+                        region.height = 108;
+                        livetrack_video_output.regions.push_back(region);
+                    }
+                }
+            }
+            std::unique_ptr<hibiscus::livetrack_report_logger> livetrack_logger;
+            {
+                const auto name_and_value = command.options.find("livetrack-log");
+                if (name_and_value != command.options.end()) {
+                    {
+                        std::ifstream input(name_and_value->second);
+                        if (input.good() && command.flags.find("force") == command.flags.end()) {
+                            throw std::runtime_error(
+                                std::string("'") + name_and_value->second
+                                + "' already exists (use --force to overwrite it)");
+                        }
+                    }
+                    livetrack_logger.reset(new hibiscus::livetrack_report_logger(name_and_value->second));
+                }
+            }
+            std::unique_ptr<hibiscus::livetrack_video_logger> livetrack_video_logger;
+            {
+                const auto name_and_value = command.options.find("livetrack-video");
+                if (name_and_value != command.options.end()) {
+                    for (const auto& filename :
+                         {name_and_value->second,
+                          name_and_value->second + hibiscus::livetrack_video_layout::index_extension}) {
+                        std::ifstream input(filename);
+                        if (input.good() && command.flags.find("force") == command.flags.end()) {
+                            throw std::runtime_error(
+                                std::string("'") + filename + "' already exists (use --force to overwrite it)");
+                        }
+                    }
+                    livetrack_video_logger.reset(new hibiscus::livetrack_video_logger(name_and_value->second));
+                }
+            }
             hummingbird::lightcrafter lightcrafter(ip, hummingbird::lightcrafter::default_settings());
             std::exception_ptr pipeline_exception;
             auto display = hummingbird::make_display(false, 608, 684, 0, 64, [](hummingbird::display_event) {});
@@ -766,19 +762,23 @@ int main(int argc, char* argv[]) {
             };
             accessing_phase.clear(std::memory_order_release);
             hibiscus::livetrack_data previous_livetrack_data;
-            auto livetrack_data_observable = hibiscus::make_livetrack_data_observable(
-                [&](hibiscus::livetrack_data livetrack_data) {
+            auto livetrack_data_observable = hibiscus::make_livetrack_data_batch_source(
+                [&](hibiscus::livetrack_data_span livetrack_data_span) {
                     while (accessing_phase.test_and_set(std::memory_order_acquire)) {
                     }
                     if (dump.is_open()) {
-                        dump << livetrack_data.t << "," << livetrack_data.left.pupil_x << ","
-                             << livetrack_data.left.pupil_y << "," << livetrack_data.left.glint_1_x << ","
-                             << livetrack_data.left.glint_1_y << "," << livetrack_data.right.pupil_x << ","
-                             << livetrack_data.right.pupil_y << "," << livetrack_data.right.glint_1_x << ","
-                             << livetrack_data.right.glint_1_y << "\r\n";
+                        for (const auto& livetrack_data : livetrack_data_span) {
+                            dump << livetrack_data.t << "," << livetrack_data.left.pupil_x << ","
+                                 << livetrack_data.left.pupil_y << "," << livetrack_data.left.glint_1_x << ","
+                                 << livetrack_data.left.glint_1_y << "," << livetrack_data.right.pupil_x << ","
+                                 << livetrack_data.right.pupil_y << "," << livetrack_data.right.glint_1_x << ","
+                                 << livetrack_data.right.glint_1_y << "\r\n";
+                        }
                     }
                     switch (app_phase) {
                         case phase::display: {
+                            // the terminal only shows the latest sample
+                            const auto& livetrack_data = *std::prev(livetrack_data_span.end());
                             chunks_and_attributes[1].first = std::to_string(livetrack_data.t);
                             if (livetrack_data.io != previous_livetrack_data.io) {
                                 std::stringstream stream;
@@ -879,16 +879,21 @@ int main(int argc, char* argv[]) {
                             break;
                         }
                         case phase::acquisition: {
-                            if (livetrack_data.left.has_pupil && livetrack_data.left.has_glint_1) {
-                                point_index_to_left_gazes[current_point_index].push_back(
-                                    {static_cast<double>(livetrack_data.left.pupil_x) - livetrack_data.left.glint_1_x,
-                                     static_cast<double>(livetrack_data.left.pupil_y) - livetrack_data.left.glint_1_y});
-                            }
-                            if (livetrack_data.right.has_pupil && livetrack_data.right.has_glint_1) {
-                                point_index_to_right_gazes[current_point_index].push_back(
-                                    {static_cast<double>(livetrack_data.right.pupil_x) - livetrack_data.right.glint_1_x,
-                                     static_cast<double>(livetrack_data.right.pupil_y)
-                                         - livetrack_data.right.glint_1_y});
+                            for (const auto& livetrack_data : livetrack_data_span) {
+                                if (livetrack_data.left.has_pupil && livetrack_data.left.has_glint_1) {
+                                    point_index_to_left_gazes[current_point_index].push_back(
+                                        {static_cast<double>(livetrack_data.left.pupil_x)
+                                             - livetrack_data.left.glint_1_x,
+                                         static_cast<double>(livetrack_data.left.pupil_y)
+                                             - livetrack_data.left.glint_1_y});
+                                }
+                                if (livetrack_data.right.has_pupil && livetrack_data.right.has_glint_1) {
+                                    point_index_to_right_gazes[current_point_index].push_back(
+                                        {static_cast<double>(livetrack_data.right.pupil_x)
+                                             - livetrack_data.right.glint_1_x,
+                                         static_cast<double>(livetrack_data.right.pupil_y)
+                                             - livetrack_data.right.glint_1_y});
+                                }
                             }
                             break;
                         }
@@ -900,21 +905,32 @@ int main(int argc, char* argv[]) {
                 [&](std::exception_ptr exception) {
                     pipeline_exception = exception;
                     display->close();
-                });
+                },
+                nullptr,
+                livetrack_replay_filename,
+                replay_speed,
+                livetrack_logger.get());
             livetrack_data_observable->start();
-            std::vector<uint8_t> downsampled_bytes(576 * 108 * 3);
+            std::vector<uint8_t> downsampled_bytes(576 * 108);
             std::vector<uint8_t> bytes(608 * 684 * 3);
+            hibiscus::latency_histogram livetrack_video_latency;
             auto livetrack_video_observable = hibiscus::make_livetrack_video_observable(
                 "/dev/video0",
-                [&](const std::vector<uint8_t>& livetrack_bytes) {
+                [&](const std::vector<uint8_t>& livetrack_bytes, std::chrono::steady_clock::time_point t) {
                     while (accessing_phase.test_and_set(std::memory_order_acquire)) {
                     }
                     switch (app_phase) {
                         case phase::display: {
                             std::fill(bytes.begin(), bytes.end(), 0);
-                            downsample(livetrack_bytes, downsampled_bytes);
+                            if (livetrack_video_output.regions.empty()) {
+                                downsample(livetrack_bytes, downsampled_bytes);
+                            } else {
+                                juxtapose(livetrack_bytes, downsampled_bytes);
+                            }
                             rotate(downsampled_bytes, bytes);
                             display->push(bytes);
+                            livetrack_video_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - t));
                             break;
                         }
                         case phase::flush: {
@@ -931,7 +947,16 @@ int main(int argc, char* argv[]) {
                 [&](std::exception_ptr exception) {
                     pipeline_exception = exception;
                     display->close();
-                });
+                },
+                nullptr,
+                video_buffers,
+                livetrack_video_output,
+                livetrack_video_logger.get());
+            if (livetrack_video_output.regions.empty()
+                && (livetrack_video_observable->width() != 640 || livetrack_video_observable->height() < 120)) {
+                throw std::runtime_error("unexpected LiveTrack preview size");
+            }
+            std::string livetrack_video_summary;
             std::atomic_bool running(true);
             std::thread play_loop([&]() {
                 auto sleep_for_while_running = [&](const std::chrono::milliseconds& duration) {
@@ -957,7 +982,18 @@ int main(int argc, char* argv[]) {
                         } else if (app_phase == phase::idle) {
                             display->start();
                             accessing_phase.clear(std::memory_order_release);
-                            livetrack_video_observable.reset();
+                            livetrack_video_summary =
+                                std::string("livetrack video: ")
+                                + std::to_string(livetrack_video_observable->captured()) + " captured, "
+                                + std::to_string(livetrack_video_observable->decoded()) + " decoded, "
+                                + std::to_string(livetrack_video_observable->dropped()) + " dropped"
+                                + "\nlivetrack video decode: "
+                                + livetrack_video_observable->decode_histogram().to_string()
+                                + "\nlivetrack video capture to display: " + livetrack_video_latency.to_string();
+                            // the video is recorded until the end of the calibration
+                            if (!livetrack_video_logger) {
+                                livetrack_video_observable.reset();
+                            }
                             break;
                         }
                         accessing_phase.clear(std::memory_order_release);
@@ -1288,6 +1324,19 @@ int main(int argc, char* argv[]) {
             display->run();
             running.store(false, std::memory_order_release);
             play_loop.join();
+            livetrack_video_observable.reset();
+            if (!livetrack_video_summary.empty() || livetrack_video_logger) {
+                // the data observable updates the terminal, which must be closed before printing
+                livetrack_data_observable.reset();
+                terminal.reset();
+                if (!livetrack_video_summary.empty()) {
+                    std::cout << livetrack_video_summary << std::endl;
+                }
+                if (livetrack_video_logger) {
+                    std::cout << "livetrack video log: " << livetrack_video_logger->frames() << " frames, "
+                              << livetrack_video_logger->dropped() << " dropped" << std::endl;
+                }
+            }
             if (pipeline_exception) {
                 std::rethrow_exception(pipeline_exception);
             }
@@ -4,7 +4,7 @@
 #include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
 #include "calibration.hpp"
-#include "livetrack_data_observable.hpp"
+#include "livetrack_replay_observable.hpp"
 #include <deque>
 
 const std::array<std::array<uint8_t, 3>, 7> on_lookup{{
@@ -35,12 +35,18 @@ int main(int argc, char* argv[]) {
             "Available options:",
             "    -i [ip], --ip [ip]                sets the LightCrafter IP address",
             "                                          defaults to 10.10.10.100",
+            "    -l [path], --livetrack-replay [path]",
+            "                                      reads the LiveTrack samples from a file instead of the eye tracker",
+            "                                          raw reports or a calibrate dump (.csv)",
+            "    -s [speed], --replay-speed [speed]",
+            "                                      sets the replay speed, 0 replays as fast as possible",
+            "                                          defaults to 1",
             "    -h, --help                            shows this help message",
         },
         argc,
         argv,
         -1,
-        {{"ip", {"i"}}},
+        {{"ip", {"i"}}, {"livetrack-replay", {"l"}}, {"replay-speed", {"s"}}},
         {},
         [](pontella::command command) {
             hibiscus::calibrations calibrations;
@@ -59,6 +65,20 @@ int main(int argc, char* argv[]) {
                     ip = hummingbird::lightcrafter::parse_ip(name_and_value->second);
                 }
             }
+            std::string livetrack_replay_filename;
+            {
+                const auto name_and_value = command.options.find("livetrack-replay");
+                if (name_and_value != command.options.end()) {
+                    livetrack_replay_filename = name_and_value->second;
+                }
+            }
+            double replay_speed = 1.0;
+            {
+                const auto name_and_value = command.options.find("replay-speed");
+                if (name_and_value != command.options.end()) {
+                    replay_speed = std::stod(name_and_value->second);
+                }
+            }
             hummingbird::lightcrafter lightcrafter(ip);
 
             std::atomic_bool running(true);
@@ -68,7 +88,7 @@ int main(int argc, char* argv[]) {
             std::atomic_flag accessing_points;
             std::deque<std::array<uint16_t, 2>> points;
             accessing_points.clear(std::memory_order_release);
-            auto livetrack_data_observable = hibiscus::make_livetrack_data_observable(
+            auto livetrack_data_observable = hibiscus::make_livetrack_data_source(
                 [&](hibiscus::livetrack_data livetrack_data) {
                     if (livetrack_data.left.has_pupil && livetrack_data.left.has_glint_1
                         && livetrack_data.right.has_pupil && livetrack_data.right.has_glint_1) {
@@ -99,7 +119,10 @@ int main(int argc, char* argv[]) {
                 [&](std::exception_ptr exception) {
                     pipeline_exception = exception;
                     running.store(false, std::memory_order_release);
-                });
+                },
+                nullptr,
+                livetrack_replay_filename,
+                replay_speed);
             livetrack_data_observable->start();
             std::vector<uint8_t> frame(343 * 342 * 3);
             std::vector<uint8_t> bytes(608 * 684 * 3);
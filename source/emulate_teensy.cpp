@@ -0,0 +1,342 @@
+#include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
+#include "pty_teensy.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+/// emulate_teensy_running is cleared by the interrupt signal handler.
+std::atomic_bool emulate_teensy_running(true);
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "emulate_teensy creates a pseudo-terminal which behaves like a Teensy running the record firmware",
+            "Syntax: ./emulate_teensy [options]",
+            "The pseudo-terminal path is printed on startup, and can be passed to record or monitor_teensy.",
+            "Available options:",
+            "    -r [factor], --rate [factor]                    multiplies the nominal event rates",
+            "                                                        defaults to 1",
+            "    -s [subframes], --subframes [subframes]         sets the number of DMD subframes per frame",
+            "                                                        defaults to 24",
+            "    -p [period], --subframe-period [period]         sets the nominal subframe period in microseconds",
+            "                                                        defaults to 1030",
+            "                                                        frames last one subframe period more",
+            "                                                        than their subframes",
+            "    -j [jitter], --jitter [jitter]                  sets the maximum DMD edge jitter in microseconds",
+            "                                                        defaults to 0",
+            "    -b [presses], --buttons [presses]               sets the nominal button presses per second",
+            "                                                        defaults to 0.5",
+            "    -t [t], --start-t [t]                           sets the initial value of the emulated micros()",
+            "                                                        use values close to 4294967295",
+            "                                                        to test clock overflows",
+            "                                                        defaults to 0",
+            "    -l [path], --link [path]                        creates a symbolic link to the pseudo-terminal",
+            "    -o [path], --output [path]                      writes the bytes read by the host to a file",
+            "                                                        which can be played back by replay_teensy",
+            "    -n, --no-extended-timestamps                    ignores 64-bit timestamps requests",
+            "                                                        like older firmwares",
+            "    -h, --help                                      shows this help message",
+        },
+        argc,
+        argv,
+        0,
+        {{"rate", {"r"}},
+         {"subframes", {"s"}},
+         {"subframe-period", {"p"}},
+         {"jitter", {"j"}},
+         {"buttons", {"b"}},
+         {"start-t", {"t"}},
+         {"link", {"l"}},
+         {"output", {"o"}}},
+        {{"no-extended-timestamps", {"n"}}},
+        [](pontella::command command) {
+            auto rate = 1.0;
+            {
+                const auto name_and_value = command.options.find("rate");
+                if (name_and_value != command.options.end()) {
+                    rate = std::stod(name_and_value->second);
+                    if (rate <= 0) {
+                        throw std::runtime_error("the rate must be strictly positive");
+                    }
+                }
+            }
+            uint64_t subframes = 24;
+            {
+                const auto name_and_value = command.options.find("subframes");
+                if (name_and_value != command.options.end()) {
+                    subframes = std::stoull(name_and_value->second);
+                    if (subframes == 0) {
+                        throw std::runtime_error("there must be at least one subframe");
+                    }
+                }
+            }
+            auto subframe_period = 1030.0;
+            {
+                const auto name_and_value = command.options.find("subframe-period");
+                if (name_and_value != command.options.end()) {
+                    subframe_period = std::stod(name_and_value->second);
+                    if (subframe_period <= 0) {
+                        throw std::runtime_error("the subframe period must be strictly positive");
+                    }
+                }
+            }
+            uint64_t jitter = 0;
+            {
+                const auto name_and_value = command.options.find("jitter");
+                if (name_and_value != command.options.end()) {
+                    jitter = std::stoull(name_and_value->second);
+                }
+            }
+            auto button_presses = 0.5;
+            {
+                const auto name_and_value = command.options.find("buttons");
+                if (name_and_value != command.options.end()) {
+                    button_presses = std::stod(name_and_value->second);
+                    if (button_presses < 0) {
+                        throw std::runtime_error("the number of button presses must be positive");
+                    }
+                }
+            }
+            uint64_t start_t = 0;
+            {
+                const auto name_and_value = command.options.find("start-t");
+                if (name_and_value != command.options.end()) {
+                    start_t = std::stoull(name_and_value->second);
+                }
+            }
+            const auto extended_timestamps =
+                command.flags.find("no-extended-timestamps") == command.flags.end();
+            subframe_period /= rate;
+            button_presses *= rate;
+            const auto tick_half_period = 8333.0 / rate;
+            const uint64_t flush_period = 100000;
+            const std::size_t frame_capacity = 32;
+
+            hibiscus::pty_teensy emulated_teensy;
+            {
+                const auto name_and_value = command.options.find("link");
+                if (name_and_value != command.options.end()) {
+                    unlink(name_and_value->second.c_str());
+                    if (symlink(emulated_teensy.filename().c_str(), name_and_value->second.c_str()) < 0) {
+                        throw std::runtime_error(
+                            std::string("linking '") + name_and_value->second + "' to '" + emulated_teensy.filename()
+                            + "' failed");
+                    }
+                }
+            }
+            {
+                const auto name_and_value = command.options.find("output");
+                if (name_and_value != command.options.end()) {
+                    emulated_teensy.open_log(name_and_value->second);
+                }
+            }
+            std::cout << emulated_teensy.filename() << std::endl;
+            std::signal(SIGINT, [](int) { emulate_teensy_running.store(false, std::memory_order_release); });
+
+            // emulated state, the timestamps are microseconds since the emulation start
+            const auto begin = std::chrono::steady_clock::now();
+            auto now = [&]() {
+                return static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin)
+                        .count());
+            };
+            auto micros = [&](uint64_t t) { return start_t + t; };
+            std::mt19937 generator(std::random_device{}());
+            std::uniform_int_distribution<int64_t> jitter_distribution(
+                -static_cast<int64_t>(jitter), static_cast<int64_t>(jitter));
+            std::exponential_distribution<double> button_distribution(button_presses > 0 ? button_presses : 1.0);
+            auto next_button_t = [&](uint64_t t) {
+                if (button_presses == 0) {
+                    return std::numeric_limits<uint64_t>::max();
+                }
+                return t + static_cast<uint64_t>(button_distribution(generator) * 1e6) + 1;
+            };
+            uint64_t subframe_index = 0;
+            uint64_t frame_t = 0;
+            uint64_t subframe_t = 0;
+            uint32_t tick = 0;
+            uint64_t tick_t = 0;
+            auto ticked = false;
+            uint64_t previous_flush_t = 0;
+            auto send_fake_event = false;
+            auto compact_frames = false;
+            uint64_t sync_half_period = 0;
+            uint64_t sync_t = 0;
+            uint32_t sync_id = 0;
+            std::vector<uint8_t> frame_message;
+            std::size_t frame_limit = 0;
+            uint64_t previous_subframe_t = 0;
+            const auto nominal_subframe_period = static_cast<uint16_t>(std::lround(subframe_period));
+            auto close_frame = [&]() {
+                if (!frame_message.empty()) {
+                    emulated_teensy.write(frame_message);
+                    frame_message.clear();
+                }
+            };
+            auto button_t = next_button_t(0);
+            auto reset = [&](uint64_t t) {
+                subframe_index = 0;
+                frame_t = t;
+                subframe_t = t;
+                tick = 0;
+                tick_t = 0;
+                ticked = false;
+                previous_flush_t = t;
+                compact_frames = false;
+                frame_message.clear();
+            };
+            reset(0);
+            uint64_t messages = 0;
+            while (emulate_teensy_running.load(std::memory_order_acquire)) {
+                const auto loop_t = now();
+                auto has_message = false;
+                while (subframe_t <= loop_t) {
+                    // compact frames rely on the periodic flush, since a flush per frame would double their size
+                    if (!compact_frames) {
+                        has_message = true;
+                    }
+                    ++messages;
+                    if (subframe_index == 0) {
+                        close_frame();
+                        if (compact_frames) {
+                            frame_message = {'g'};
+                            emulated_teensy.append_t(frame_message, micros(subframe_t));
+                            frame_message.push_back(static_cast<uint8_t>(nominal_subframe_period & 0xff));
+                            frame_message.push_back(static_cast<uint8_t>((nominal_subframe_period >> 8) & 0xff));
+                            frame_limit = frame_message.size() + frame_capacity;
+                        } else {
+                            emulated_teensy.send('d', micros(subframe_t));
+                        }
+                        tick_t = subframe_t;
+                        ticked = true;
+                        ++tick;
+                    } else {
+                        const auto deviation = static_cast<int64_t>(subframe_t - previous_subframe_t)
+                                               - static_cast<int64_t>(nominal_subframe_period);
+                        if (!frame_message.empty() && frame_message.size() < frame_limit
+                            && deviation >= std::numeric_limits<int8_t>::min()
+                            && deviation <= std::numeric_limits<int8_t>::max()) {
+                            frame_message.push_back(static_cast<uint8_t>(deviation + 128));
+                        } else {
+                            close_frame();
+                            emulated_teensy.send('e', micros(subframe_t));
+                            has_message = true;
+                        }
+                    }
+                    previous_subframe_t = subframe_t;
+                    ++subframe_index;
+                    if (subframe_index == subframes) {
+                        close_frame();
+                        subframe_index = 0;
+                        frame_t += static_cast<uint64_t>(subframe_period * (subframes + 1));
+                    }
+                    subframe_t = frame_t + static_cast<uint64_t>(subframe_period * subframe_index);
+                    const auto offset = jitter_distribution(generator);
+                    if (offset > 0 || static_cast<uint64_t>(-offset) < subframe_t) {
+                        subframe_t += offset;
+                    }
+                }
+                if (button_t <= loop_t) {
+                    has_message = true;
+                    ++messages;
+                    emulated_teensy.send(generator() % 2 == 0 ? 'l' : 'r', micros(button_t));
+                    button_t = next_button_t(button_t);
+                }
+                if (sync_half_period > 0 && sync_t + sync_half_period <= loop_t) {
+                    has_message = true;
+                    ++messages;
+                    ++sync_id;
+                    std::vector<uint8_t> message{'s'};
+                    emulated_teensy.append_t(message, micros(loop_t));
+                    for (std::size_t index = 0; index < 4; ++index) {
+                        message.push_back(static_cast<uint8_t>((sync_id >> (8 * index)) & 0xff));
+                    }
+                    emulated_teensy.write(message);
+                    sync_t += sync_half_period;
+                    if (sync_t + sync_half_period <= loop_t) {
+                        sync_t = loop_t;
+                    }
+                }
+                if (send_fake_event) {
+                    send_fake_event = false;
+                    has_message = true;
+                    ++messages;
+                    emulated_teensy.send(loop_t % 2 == 0 ? 'l' : 'r', micros(loop_t));
+                }
+                if (frame_message.empty() && (has_message || loop_t - previous_flush_t > flush_period)) {
+                    emulated_teensy.send('f', micros(loop_t));
+                    previous_flush_t = loop_t;
+                }
+                if (ticked && now() - tick_t > tick_half_period) {
+                    emulated_teensy.send_value('c', tick);
+                    ticked = false;
+                }
+                emulated_teensy.flush();
+                auto next_t = std::min(std::min(subframe_t, button_t), previous_flush_t + flush_period);
+                if (sync_half_period > 0) {
+                    next_t = std::min(next_t, sync_t + sync_half_period);
+                }
+                if (ticked) {
+                    next_t = std::min(next_t, tick_t + static_cast<uint64_t>(tick_half_period));
+                }
+                const auto read_t = now();
+                emulated_teensy.read(
+                    std::chrono::microseconds(next_t > read_t ? next_t - read_t : 0),
+                    [&](const std::vector<uint8_t>& message) {
+                        if (message.size() == 1) {
+                            switch (message[0]) {
+                                case 'a':
+                                case 'b':
+                                    emulated_teensy.send(message[0], micros(now()));
+                                    break;
+                                case 'r':
+                                    emulated_teensy.set_extended_timestamps(false);
+                                    sync_half_period = 0;
+                                    reset(now());
+                                    emulated_teensy.write({'r'});
+                                    break;
+                                case 'f':
+                                    send_fake_event = true;
+                                    break;
+                                case 'p':
+                                    compact_frames = true;
+                                    break;
+                                case 'x':
+                                    if (extended_timestamps) {
+                                        emulated_teensy.set_extended_timestamps(true);
+                                        emulated_teensy.write({'x'});
+                                    }
+                                    break;
+                                default:
+                                    break;
+                            }
+                            emulated_teensy.flush();
+                        } else if (message.size() == 5 && message[0] == 's') {
+                            sync_half_period =
+                                static_cast<uint64_t>(message[1]) | (static_cast<uint64_t>(message[2]) << 8)
+                                | (static_cast<uint64_t>(message[3]) << 16) | (static_cast<uint64_t>(message[4]) << 24);
+                            sync_id = 0;
+                            sync_t = now();
+                        }
+                    });
+            }
+            const auto duration = now();
+            std::cout << messages << " events in " << duration / 1000000.0 << " s ("
+                      << static_cast<uint64_t>(messages * 1e6 / (duration > 0 ? duration : 1)) << " events per second, "
+                      << emulated_teensy.written_messages() << " messages, " << emulated_teensy.written_bytes()
+                      << " bytes sent, " << emulated_teensy.dropped_bytes() << " bytes dropped)" << std::endl;
+            {
+                const auto name_and_value = command.options.find("link");
+                if (name_and_value != command.options.end()) {
+                    unlink(name_and_value->second.c_str());
+                }
+            }
+        });
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// gaze_event_type enumerates the events detected by a gaze_classifier.
+    /// The values are the ASCII types used in the record output.
+    enum class gaze_event_type : uint8_t {
+        fixation = 'F',
+        saccade = 'S',
+        blink = 'B',
+    };
+
+    /// gaze_event represents a fixation, a saccade or a blink.
+    /// For fixations, begin_x and begin_y hold the mean position and end_x and end_y are equal to them.
+    /// For blinks, the positions are the last position before and the first position after the blink.
+    struct gaze_event {
+        gaze_event_type type;
+        uint64_t begin_t;
+        uint64_t end_t;
+        double begin_x;
+        double begin_y;
+        double end_x;
+        double end_y;
+        double peak_velocity;
+    };
+
+    /// gaze_event_to_bytes encodes a gaze event as a generic event payload.
+    /// The payload contains the type, the eye (0 for left, 1 for right), the begin and end timestamps (uint64),
+    /// the begin and end positions and the peak velocity (double floats), in little endian.
+    inline std::vector<uint8_t> gaze_event_to_bytes(const gaze_event& event, uint8_t eye) {
+        std::vector<uint8_t> bytes(58);
+        bytes[0] = static_cast<uint8_t>(event.type);
+        bytes[1] = eye;
+        std::array<uint64_t, 7> values{{event.begin_t, event.end_t}};
+        std::size_t value_index = 2;
+        for (const auto value : {event.begin_x, event.begin_y, event.end_x, event.end_y, event.peak_velocity}) {
+            std::memcpy(&values[value_index], &value, sizeof(value));
+            ++value_index;
+        }
+        for (value_index = 0; value_index < values.size(); ++value_index) {
+            for (std::size_t index = 0; index < 8; ++index) {
+                bytes[2 + value_index * 8 + index] = static_cast<uint8_t>((values[value_index] >> (8 * index)) & 0xff);
+            }
+        }
+        return bytes;
+    }
+
+    /// gaze_classifier_parameters configures a gaze_classifier.
+    /// Positions are expressed in screen pixels, velocities in pixels per second and durations in microseconds.
+    struct gaze_classifier_parameters {
+        /// minimum_cutoff is the One Euro filter cutoff frequency at rest, in Hz.
+        double minimum_cutoff = 5.0;
+
+        /// beta is the One Euro filter cutoff increase per unit of speed.
+        double beta = 0.01;
+
+        /// derivative_cutoff is the cutoff frequency of the speed estimate used to adapt the filter, in Hz.
+        double derivative_cutoff = 1.0;
+
+        /// initial_threshold is the saccade velocity threshold before the noise estimate converges.
+        double initial_threshold = 1000.0;
+
+        /// minimum_threshold bounds the adaptive saccade velocity threshold.
+        double minimum_threshold = 300.0;
+
+        /// noise_factor is the number of standard deviations above the mean fixation velocity
+        /// which defines the adaptive threshold.
+        double noise_factor = 6.0;
+
+        /// noise_adaptation is the weight of each fixation sample in the velocity noise estimate.
+        double noise_adaptation = 0.002;
+
+        /// minimum_fixation_duration is the shortest fixation reported.
+        uint64_t minimum_fixation_duration = 50000;
+
+        /// minimum_saccade_duration is the shortest saccade reported.
+        uint64_t minimum_saccade_duration = 6000;
+
+        /// minimum_blink_duration is the shortest pupil loss reported as a blink.
+        uint64_t minimum_blink_duration = 50000;
+
+        /// maximum_blink_duration is the longest pupil loss reported as a blink, longer losses are ignored.
+        uint64_t maximum_blink_duration = 500000;
+    };
+
+    /// gaze_classifier segments a single eye's gaze stream into fixations, saccades and blinks.
+    /// Samples are smoothed with a One Euro filter, and a sample belongs to a saccade if the smoothed velocity
+    /// exceeds a threshold derived from a running estimate of the fixation velocity noise.
+    /// Blinks are pupil losses with a duration in the configured range.
+    /// Each sample is processed in constant time, and events are emitted as soon as they end.
+    template <typename HandleGazeEvent>
+    class gaze_classifier {
+        public:
+        gaze_classifier(HandleGazeEvent handle_gaze_event, gaze_classifier_parameters parameters) :
+            _handle_gaze_event(std::forward<HandleGazeEvent>(handle_gaze_event)),
+            _parameters(parameters),
+            _state(state::lost),
+            _threshold(parameters.initial_threshold),
+            _noise_mean(0.0),
+            _noise_variance(0.0),
+            _noise_samples(0),
+            _lost_t(0),
+            _t(0) {}
+        gaze_classifier(const gaze_classifier&) = delete;
+        gaze_classifier(gaze_classifier&&) = default;
+        gaze_classifier& operator=(const gaze_classifier&) = delete;
+        gaze_classifier& operator=(gaze_classifier&&) = default;
+        virtual ~gaze_classifier() {}
+
+        /// push processes a sample with a valid pupil.
+        virtual void push(uint64_t t, double x, double y) {
+            if (_state == state::lost) {
+                if (_lost_t > 0) {
+                    const auto duration = t - _lost_t;
+                    if (duration >= _parameters.minimum_blink_duration
+                        && duration <= _parameters.maximum_blink_duration) {
+                        _handle_gaze_event(gaze_event{
+                            gaze_event_type::blink, _lost_t, t, _filtered_x, _filtered_y, x, y, 0.0});
+                    }
+                }
+                reset(t, x, y);
+                return;
+            }
+            if (t <= _t) {
+                return;
+            }
+            const auto dt = (t - _t) * 1e-6;
+            const auto previous_x = _filtered_x;
+            const auto previous_y = _filtered_y;
+            filter(dt, x, y);
+            const auto velocity = std::hypot(_filtered_x - previous_x, _filtered_y - previous_y) / dt;
+            if (_state == state::fixation) {
+                if (velocity > _threshold) {
+                    close_fixation();
+                    _state = state::saccade;
+                    _begin_t = _t;
+                    _begin_x = previous_x;
+                    _begin_y = previous_y;
+                    _peak_velocity = velocity;
+                } else {
+                    adapt(velocity);
+                    _sum_x += _filtered_x;
+                    _sum_y += _filtered_y;
+                    ++_samples;
+                }
+            } else if (velocity > _threshold) {
+                _peak_velocity = std::max(_peak_velocity, velocity);
+            } else {
+                if (_t - _begin_t >= _parameters.minimum_saccade_duration) {
+                    _handle_gaze_event(gaze_event{
+                        gaze_event_type::saccade,
+                        _begin_t,
+                        _t,
+                        _begin_x,
+                        _begin_y,
+                        previous_x,
+                        previous_y,
+                        _peak_velocity});
+                }
+                open_fixation(t);
+            }
+            _t = t;
+        }
+
+        /// push_lost processes a sample without pupil.
+        virtual void push_lost(uint64_t t) {
+            if (_state == state::lost) {
+                return;
+            }
+            close_fixation();
+            _state = state::lost;
+            _lost_t = t;
+        }
+
+        /// threshold returns the current saccade velocity threshold.
+        double threshold() const {
+            return _threshold;
+        }
+
+        protected:
+        /// state enumerates the classifier states.
+        enum class state : uint8_t {
+            lost,
+            fixation,
+            saccade,
+        };
+
+        /// reset restarts the filter and opens a fixation after a pupil loss.
+        void reset(uint64_t t, double x, double y) {
+            _t = t;
+            _filtered_x = x;
+            _filtered_y = y;
+            _filtered_dx = 0.0;
+            _filtered_dy = 0.0;
+            _state = state::fixation;
+            open_fixation(t);
+        }
+
+        /// filter updates the One Euro filter with a new position.
+        void filter(double dt, double x, double y) {
+            const auto derivative_alpha = alpha(_parameters.derivative_cutoff, dt);
+            _filtered_dx += derivative_alpha * ((x - _filtered_x) / dt - _filtered_dx);
+            _filtered_dy += derivative_alpha * ((y - _filtered_y) / dt - _filtered_dy);
+            const auto position_alpha = alpha(
+                _parameters.minimum_cutoff + _parameters.beta * std::hypot(_filtered_dx, _filtered_dy), dt);
+            _filtered_x += position_alpha * (x - _filtered_x);
+            _filtered_y += position_alpha * (y - _filtered_y);
+        }
+
+        /// alpha returns the smoothing factor of a first-order low-pass filter.
+        static double alpha(double cutoff, double dt) {
+            return 1.0 / (1.0 + 1.0 / (2.0 * M_PI * cutoff * dt));
+        }
+
+        /// adapt updates the fixation velocity noise estimate and the threshold.
+        void adapt(double velocity) {
+            const auto weight = std::max(_parameters.noise_adaptation, 1.0 / ++_noise_samples);
+            const auto delta = velocity - _noise_mean;
+            _noise_mean += weight * delta;
+            _noise_variance = (1.0 - weight) * (_noise_variance + weight * delta * delta);
+            if (_noise_samples * _parameters.noise_adaptation >= 1.0) {
+                _threshold = std::max(
+                    _parameters.minimum_threshold,
+                    _noise_mean + _parameters.noise_factor * std::sqrt(_noise_variance));
+            }
+        }
+
+        /// open_fixation starts accumulating a fixation.
+        void open_fixation(uint64_t t) {
+            _state = state::fixation;
+            _begin_t = t;
+            _sum_x = _filtered_x;
+            _sum_y = _filtered_y;
+            _samples = 1;
+        }
+
+        /// close_fixation emits the current fixation if it is long enough.
+        void close_fixation() {
+            if (_state == state::fixation && _t - _begin_t >= _parameters.minimum_fixation_duration) {
+                const auto x = _sum_x / _samples;
+                const auto y = _sum_y / _samples;
+                _handle_gaze_event(gaze_event{gaze_event_type::fixation, _begin_t, _t, x, y, x, y, 0.0});
+            }
+        }
+
+        HandleGazeEvent _handle_gaze_event;
+        const gaze_classifier_parameters _parameters;
+        state _state;
+        double _threshold;
+        double _noise_mean;
+        double _noise_variance;
+        uint64_t _noise_samples;
+        uint64_t _lost_t;
+        uint64_t _t;
+        double _filtered_x;
+        double _filtered_y;
+        double _filtered_dx;
+        double _filtered_dy;
+        uint64_t _begin_t;
+        double _begin_x;
+        double _begin_y;
+        double _peak_velocity;
+        double _sum_x;
+        double _sum_y;
+        uint64_t _samples;
+    };
+
+    /// make_gaze_classifier creates a gaze classifier from a functor.
+    template <typename HandleGazeEvent>
+    std::unique_ptr<gaze_classifier<HandleGazeEvent>>
+    make_gaze_classifier(HandleGazeEvent handle_gaze_event, gaze_classifier_parameters parameters = {}) {
+        return std::unique_ptr<gaze_classifier<HandleGazeEvent>>(
+            new gaze_classifier<HandleGazeEvent>(std::forward<HandleGazeEvent>(handle_gaze_event), parameters));
+    }
+}
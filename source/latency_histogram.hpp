@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// latency_histogram counts durations in linear bins.
+    /// It can be updated by one thread while other threads read it.
+    class latency_histogram {
+        public:
+        /// bin_duration is the width of a bin in microseconds.
+        static constexpr uint64_t bin_duration = 100;
+
+        /// bins is the number of bins, the last one counts every duration larger than the others.
+        static constexpr std::size_t bins = 201;
+
+        latency_histogram() : _maximum(0) {
+            for (auto& count : _counts) {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+        latency_histogram(const latency_histogram&) = delete;
+        latency_histogram(latency_histogram&&) = delete;
+        latency_histogram& operator=(const latency_histogram&) = delete;
+        latency_histogram& operator=(latency_histogram&&) = delete;
+        virtual ~latency_histogram() {}
+
+        /// add counts a duration.
+        void add(std::chrono::microseconds duration) {
+            const auto value = static_cast<uint64_t>(duration.count() < 0 ? 0 : duration.count());
+            const auto index = value / bin_duration;
+            _counts[index < bins ? index : bins - 1].fetch_add(1, std::memory_order_relaxed);
+            if (value > _maximum.load(std::memory_order_relaxed)) {
+                _maximum.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        /// count returns the number of durations in the given bin.
+        uint64_t count(std::size_t index) const {
+            return _counts[index].load(std::memory_order_relaxed);
+        }
+
+        /// total returns the number of durations.
+        uint64_t total() const {
+            uint64_t result = 0;
+            for (const auto& count : _counts) {
+                result += count.load(std::memory_order_relaxed);
+            }
+            return result;
+        }
+
+        /// maximum returns the largest duration in microseconds.
+        uint64_t maximum() const {
+            return _maximum.load(std::memory_order_relaxed);
+        }
+
+        /// quantile returns the upper bound in microseconds of the bin which contains the given quantile.
+        uint64_t quantile(double ratio) const {
+            const auto target = static_cast<uint64_t>(ratio * total());
+            uint64_t cumulative = 0;
+            for (std::size_t index = 0; index < bins - 1; ++index) {
+                cumulative += count(index);
+                if (cumulative > target) {
+                    return (index + 1) * bin_duration;
+                }
+            }
+            return maximum();
+        }
+
+        /// to_string summarises the histogram in a single line.
+        std::string to_string() const {
+            if (total() == 0) {
+                return "no samples";
+            }
+            return std::to_string(total()) + " samples, median < " + std::to_string(quantile(0.5))
+                   + " us, 99th percentile < " + std::to_string(quantile(0.99)) + " us, maximum "
+                   + std::to_string(maximum()) + " us";
+        }
+
+        protected:
+        std::array<std::atomic<uint64_t>, bins> _counts;
+        std::atomic<uint64_t> _maximum;
+    };
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// line maps x values to y values.
+    /// y = y_reference + slope * (x - x_reference)
+    struct line {
+        bool ready;
+        double x_reference;
+        double y_reference;
+        double slope;
+
+        /// y returns the value predicted for x.
+        double y(double x) const {
+            return y_reference + slope * (x - x_reference);
+        }
+
+        /// x returns the x value which predicts y.
+        double x(double y) const {
+            return x_reference + (y - y_reference) / slope;
+        }
+    };
+
+    /// sliding_line_fit fits a line to the most recent samples with outlier rejection.
+    /// The line is first fitted to every sample, samples whose residual is further than three scaled median
+    /// absolute deviations from the median residual are rejected, and the line is fitted again to the inliers.
+    /// It is not thread-safe.
+    class sliding_line_fit {
+        public:
+        sliding_line_fit(std::size_t window, double minimum_threshold) :
+            _window(window),
+            _minimum_threshold(minimum_threshold),
+            _index(0),
+            _model{false, 0, 0, 1},
+            _threshold(minimum_threshold),
+            _jitter(0) {
+            _samples.reserve(window);
+            _residuals.reserve(window);
+            _deviations.reserve(window);
+            _inliers.reserve(window);
+        }
+        sliding_line_fit(const sliding_line_fit&) = default;
+        sliding_line_fit(sliding_line_fit&&) = default;
+        sliding_line_fit& operator=(const sliding_line_fit&) = default;
+        sliding_line_fit& operator=(sliding_line_fit&&) = default;
+        virtual ~sliding_line_fit() {}
+
+        /// add inserts a sample, replacing the oldest one if the window is full, and updates the line.
+        virtual void add(double x, double y) {
+            const sample new_sample{x, y};
+            if (_samples.size() < _window) {
+                _samples.push_back(new_sample);
+            } else {
+                _samples[_index] = new_sample;
+                _index = (_index + 1) % _window;
+            }
+            _inliers.assign(_samples.size(), true);
+            auto new_model = fit();
+            if (!new_model.ready) {
+                return;
+            }
+            _residuals.clear();
+            for (const auto& current_sample : _samples) {
+                _residuals.push_back(residual(new_model, current_sample));
+            }
+            const auto median_residual = median(_residuals);
+            _deviations.clear();
+            for (const auto current_residual : _residuals) {
+                _deviations.push_back(std::abs(current_residual - median_residual));
+            }
+            _threshold = std::max(3 * 1.4826 * median(_deviations), _minimum_threshold);
+            for (std::size_t index = 0; index < _samples.size(); ++index) {
+                _inliers[index] = std::abs(residual(new_model, _samples[index]) - median_residual) <= _threshold;
+            }
+            const auto inliers_model = fit();
+            if (inliers_model.ready) {
+                new_model = inliers_model;
+            }
+            auto squares_sum = 0.0;
+            std::size_t inliers = 0;
+            for (const auto& current_sample : _samples) {
+                const auto current_residual = residual(new_model, current_sample);
+                if (std::abs(current_residual) <= _threshold) {
+                    squares_sum += current_residual * current_residual;
+                    ++inliers;
+                }
+            }
+            _model = new_model;
+            _jitter = inliers > 0 ? std::sqrt(squares_sum / inliers) : 0.0;
+        }
+
+        /// model returns the current line.
+        const line& model() const {
+            return _model;
+        }
+
+        /// residual returns the difference between y and the current line's prediction for x.
+        double residual(double x, double y) const {
+            return y - _model.y(x);
+        }
+
+        /// threshold returns the current outlier rejection threshold.
+        double threshold() const {
+            return _threshold;
+        }
+
+        /// jitter returns the root mean square of the inliers' residuals.
+        double jitter() const {
+            return _jitter;
+        }
+
+        /// size returns the number of samples in the window.
+        std::size_t size() const {
+            return _samples.size();
+        }
+
+        protected:
+        /// sample is a pair of x and y values.
+        struct sample {
+            double x;
+            double y;
+        };
+
+        /// fit calculates the least-squares line of the inliers.
+        line fit() const {
+            auto x_sum = 0.0;
+            auto y_sum = 0.0;
+            std::size_t count = 0;
+            for (std::size_t index = 0; index < _samples.size(); ++index) {
+                if (_inliers[index]) {
+                    x_sum += _samples[index].x;
+                    y_sum += _samples[index].y;
+                    ++count;
+                }
+            }
+            if (count < 2) {
+                return {false, 0, 0, 1};
+            }
+            const auto x_reference = x_sum / count;
+            const auto y_reference = y_sum / count;
+            auto products_sum = 0.0;
+            auto squares_sum = 0.0;
+            for (std::size_t index = 0; index < _samples.size(); ++index) {
+                if (_inliers[index]) {
+                    const auto x_delta = _samples[index].x - x_reference;
+                    products_sum += x_delta * (_samples[index].y - y_reference);
+                    squares_sum += x_delta * x_delta;
+                }
+            }
+            if (squares_sum == 0) {
+                return {false, 0, 0, 1};
+            }
+            return {true, x_reference, y_reference, products_sum / squares_sum};
+        }
+
+        /// residual returns the difference between a sample's y value and the line's prediction.
+        static double residual(const line& current_model, const sample& current_sample) {
+            return current_sample.y - current_model.y(current_sample.x);
+        }
+
+        /// median returns the median of the given values, which are reordered.
+        static double median(std::vector<double>& values) {
+            const auto middle = values.begin() + values.size() / 2;
+            std::nth_element(values.begin(), middle, values.end());
+            return *middle;
+        }
+
+        std::size_t _window;
+        double _minimum_threshold;
+        std::vector<sample> _samples;
+        std::size_t _index;
+        std::vector<double> _residuals;
+        std::vector<double> _deviations;
+        std::vector<bool> _inliers;
+        line _model;
+        double _threshold;
+        double _jitter;
+    };
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "line_fit.hpp"
+#include <cmath>
+#include <cstdint>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// livetrack_clock maps LiveTrack timestamps to Teensy timestamps with an affine model.
+    /// The model is fitted over a sliding window of sync edges with outlier rejection (see sliding_line_fit).
+    /// The LiveTrack only samples the sync input once per frame, hence the edge is estimated as the midpoint
+    /// between the last sample before the edge and the first sample after it.
+    /// It must be used by a single thread.
+    class livetrack_clock {
+        public:
+        livetrack_clock(std::size_t window) : _fit(window, 1.0), _edges(0), _rejected_edges(0), _residual(0) {}
+        livetrack_clock(const livetrack_clock&) = delete;
+        livetrack_clock(livetrack_clock&&) = default;
+        livetrack_clock& operator=(const livetrack_clock&) = delete;
+        livetrack_clock& operator=(livetrack_clock&&) = default;
+        virtual ~livetrack_clock() {}
+
+        /// edge_t estimates the LiveTrack timestamp of an edge from the samples surrounding it.
+        static double edge_t(uint64_t before_edge_t, uint64_t after_edge_t) {
+            return (static_cast<double>(before_edge_t) + static_cast<double>(after_edge_t)) / 2;
+        }
+
+        /// add updates the model with a sync edge, and returns true if the edge was consistent with the previous
+        /// model (or if there was no previous model).
+        virtual bool add(double livetrack_t, uint64_t teensy_t) {
+            auto consistent = true;
+            if (_fit.model().ready) {
+                _residual = _fit.residual(livetrack_t, static_cast<double>(teensy_t));
+                if (std::abs(_residual) > _fit.threshold()) {
+                    consistent = false;
+                    ++_rejected_edges;
+                }
+            }
+            _fit.add(livetrack_t, static_cast<double>(teensy_t));
+            ++_edges;
+            return consistent;
+        }
+
+        /// ready returns true once the model can convert timestamps.
+        bool ready() const {
+            return _fit.model().ready;
+        }
+
+        /// livetrack_to_teensy converts a LiveTrack timestamp to a Teensy timestamp.
+        uint64_t livetrack_to_teensy(uint64_t livetrack_t) const {
+            const auto teensy_t = _fit.model().y(static_cast<double>(livetrack_t));
+            return teensy_t < 0 ? 0 : static_cast<uint64_t>(std::llround(teensy_t));
+        }
+
+        /// residual returns the difference in microseconds between the last edge's Teensy timestamp
+        /// and the prediction of the model before that edge was added.
+        double residual() const {
+            return _residual;
+        }
+
+        /// drift returns the LiveTrack clock drift relative to the Teensy clock, in parts per million.
+        double drift() const {
+            return (_fit.model().slope - 1) * 1e6;
+        }
+
+        /// jitter returns the root mean square of the inliers' residuals, in microseconds.
+        double jitter() const {
+            return _fit.jitter();
+        }
+
+        /// edges returns the number of sync edges.
+        uint64_t edges() const {
+            return _edges;
+        }
+
+        /// rejected_edges returns the number of sync edges inconsistent with the previous model.
+        uint64_t rejected_edges() const {
+            return _rejected_edges;
+        }
+
+        protected:
+        sliding_line_fit _fit;
+        uint64_t _edges;
+        uint64_t _rejected_edges;
+        double _residual;
+    };
+}
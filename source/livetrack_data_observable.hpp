@@ -1,12 +1,26 @@
 #pragma once
 
 #include "../third_party/hidapi/hidapi.h"
+#include "livetrack_report_logger.hpp"
+#include "reactor.hpp"
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <time.h>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #ifdef _WIN32
 #define HIBISCUS_PACK(declaration) __pragma(pack(push, 1)) declaration __pragma(pack(pop))
@@ -42,109 +56,367 @@ namespace hibiscus {
         eye_livetrack_data right;
     });
 
-    /// livetrack_data_observable handles the connection to a LiveTrack eye tracker.
-    template <typename HandleLivetrackData, typename HandleException>
-    class livetrack_data_observable {
+    /// livetrack_report_layout lists the fields of a 64-bytes LiveTrack report.
+    /// Multi-bytes fields are little-endian.
+    /// Each eye is encoded as a status byte (enabled, has pupil, has glint 1 and has glint 2 in bits 0 to 3),
+    /// followed by eight 24-bits fields in the order of eye_livetrack_data.
+    namespace livetrack_report_layout {
+        /// size is the number of bytes in a report.
+        constexpr std::size_t size = 64;
+
+        /// io is the offset of the 32-bits io field.
+        constexpr std::size_t io = 2;
+
+        /// t is the offset of the 64-bits timestamp.
+        constexpr std::size_t t = 6;
+
+        /// eye_fields is the number of 24-bits fields per eye.
+        constexpr std::size_t eye_fields = 8;
+
+        /// left_status is the offset of the left eye's status byte.
+        constexpr std::size_t left_status = 14;
+
+        /// right_status is the offset of the right eye's status byte.
+        constexpr std::size_t right_status = 39;
+
+        /// fields returns the offset of the first 24-bits field of the eye with the given status offset.
+        constexpr std::size_t fields(std::size_t status) {
+            return status + 1;
+        }
+    }
+
+    /// decode_livetrack_eye_fields_scalar decodes the 24-bits fields of an eye, starting at the given bytes.
+    /// It is the reference implementation for the vectorized decoders.
+    inline void decode_livetrack_eye_fields_scalar(const uint8_t* bytes, uint32_t* fields) {
+        for (std::size_t index = 0; index < livetrack_report_layout::eye_fields; ++index) {
+            fields[index] = static_cast<uint32_t>(bytes[index * 3]) | (static_cast<uint32_t>(bytes[index * 3 + 1]) << 8)
+                            | (static_cast<uint32_t>(bytes[index * 3 + 2]) << 16);
+        }
+    }
+
+    /// decode_livetrack_eye_fields decodes the 24-bits fields of an eye, starting at the given bytes.
+    /// The fields are expanded to 32 bits with byte shuffles on SSSE3 and AArch64 processors,
+    /// and with the scalar implementation otherwise.
+    /// The second half of the fields is loaded from bytes[8] so that the eight fields (24 bytes) are covered
+    /// without reading past them.
+    inline void decode_livetrack_eye_fields(const uint8_t* bytes, uint32_t* fields) {
+#if defined(__SSSE3__)
+        const auto low_shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const auto high_shuffle = _mm_setr_epi8(4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15, -1);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(fields),
+            _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)), low_shuffle));
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(fields + 4),
+            _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 8)), high_shuffle));
+#elif defined(__aarch64__)
+        const uint8_t low_indices[16] = {0, 1, 2, 0xff, 3, 4, 5, 0xff, 6, 7, 8, 0xff, 9, 10, 11, 0xff};
+        const uint8_t high_indices[16] = {4, 5, 6, 0xff, 7, 8, 9, 0xff, 10, 11, 12, 0xff, 13, 14, 15, 0xff};
+        vst1q_u8(reinterpret_cast<uint8_t*>(fields), vqtbl1q_u8(vld1q_u8(bytes), vld1q_u8(low_indices)));
+        vst1q_u8(reinterpret_cast<uint8_t*>(fields + 4), vqtbl1q_u8(vld1q_u8(bytes + 8), vld1q_u8(high_indices)));
+#else
+        decode_livetrack_eye_fields_scalar(bytes, fields);
+#endif
+    }
+
+    /// decode_livetrack_eye decodes an eye's status byte and fields.
+    template <void (*DecodeFields)(const uint8_t*, uint32_t*)>
+    eye_livetrack_data decode_livetrack_eye(const uint8_t* report, std::size_t status) {
+        std::array<uint32_t, livetrack_report_layout::eye_fields> fields;
+        DecodeFields(report + livetrack_report_layout::fields(status), fields.data());
+        return {
+            fields[0],
+            fields[1],
+            fields[2],
+            fields[3],
+            fields[4],
+            fields[5],
+            fields[6],
+            fields[7],
+            (report[status] & 1) == 1,
+            ((report[status] >> 1) & 1) == 1,
+            ((report[status] >> 2) & 1) == 1,
+            ((report[status] >> 3) & 1) == 1,
+        };
+    }
+
+    /// decode_livetrack_report decodes a report with the given fields decoder.
+    template <void (*DecodeFields)(const uint8_t*, uint32_t*)>
+    livetrack_data decode_livetrack_report(const uint8_t* report) {
+        uint64_t t = 0;
+        for (std::size_t index = 0; index < 8; ++index) {
+            t |= static_cast<uint64_t>(report[livetrack_report_layout::t + index]) << (8 * index);
+        }
+        uint32_t io = 0;
+        for (std::size_t index = 0; index < 4; ++index) {
+            io |= static_cast<uint32_t>(report[livetrack_report_layout::io + index]) << (8 * index);
+        }
+        return {
+            t,
+            io,
+            decode_livetrack_eye<DecodeFields>(report, livetrack_report_layout::left_status),
+            decode_livetrack_eye<DecodeFields>(report, livetrack_report_layout::right_status),
+        };
+    }
+
+    /// report_to_livetrack_data decodes a 64-bytes LiveTrack report.
+    inline livetrack_data report_to_livetrack_data(const uint8_t* report) {
+        return decode_livetrack_report<decode_livetrack_eye_fields>(report);
+    }
+
+    /// report_to_livetrack_data_scalar decodes a 64-bytes LiveTrack report without vector instructions.
+    inline livetrack_data report_to_livetrack_data_scalar(const uint8_t* report) {
+        return decode_livetrack_report<decode_livetrack_eye_fields_scalar>(report);
+    }
+
+    /// livetrack_data_span points to consecutive samples.
+    /// The samples are only valid during the handler call.
+    class livetrack_data_span {
+        public:
+        livetrack_data_span(const livetrack_data* begin, const livetrack_data* end) : _begin(begin), _end(end) {}
+
+        /// begin returns a pointer to the first sample.
+        const livetrack_data* begin() const {
+            return _begin;
+        }
+
+        /// end returns a pointer past the last sample.
+        const livetrack_data* end() const {
+            return _end;
+        }
+
+        /// size returns the number of samples.
+        std::size_t size() const {
+            return static_cast<std::size_t>(_end - _begin);
+        }
+
+        protected:
+        const livetrack_data* _begin;
+        const livetrack_data* _end;
+    };
+
+    /// livetrack_statistics summarises the acquisition of a LiveTrack data source.
+    struct livetrack_statistics {
+        /// samples is the number of decoded samples.
+        uint64_t samples;
+
+        /// batches is the number of wakeups which yielded at least one sample.
+        uint64_t batches;
+
+        /// cpu_duration is the CPU time spent reading, decoding and handling the samples.
+        std::chrono::nanoseconds cpu_duration;
+
+        /// duration is the time elapsed since the acquisition started.
+        std::chrono::steady_clock::duration duration;
+
+        /// time_to_first_sample is the delay between the last call to start and the first delivered sample,
+        /// or a negative duration if no sample was delivered since then.
+        std::chrono::steady_clock::duration time_to_first_sample;
+
+        /// to_string summarises the statistics in a single line.
+        std::string to_string() const {
+            if (samples == 0) {
+                return "no samples";
+            }
+            auto result = std::to_string(samples) + " samples ("
+                          + std::to_string(static_cast<uint64_t>(
+                              samples / std::chrono::duration_cast<std::chrono::duration<double>>(duration).count()))
+                          + " samples/s), " + std::to_string(samples / batches) + " samples per batch on average, "
+                          + std::to_string(cpu_duration.count() / samples) + " ns of CPU per sample";
+            if (time_to_first_sample.count() >= 0) {
+                result += ", first sample after "
+                          + std::to_string(
+                              std::chrono::duration_cast<std::chrono::microseconds>(time_to_first_sample).count())
+                          + " us";
+            }
+            return result;
+        }
+    };
+
+    /// livetrack_state is the acquisition state of a LiveTrack data source.
+    /// start moves an idle source to starting, the source moves itself to running once the acquisition
+    /// actually began, stop moves it back to idle, and destruction moves it to closing.
+    enum class livetrack_state : uint8_t {
+        idle,
+        starting,
+        running,
+        closing,
+    };
+
+    /// livetrack_data_source is the interface shared by the LiveTrack observables.
+    /// It holds the acquisition state, and counts the samples and the CPU time spent producing and handling them.
+    /// Acquisition threads block on a condition variable while the source is idle.
+    class livetrack_data_source {
         public:
-        livetrack_data_observable(HandleLivetrackData handle_livetrack_data, HandleException handle_exception) :
-            _running(true),
+        livetrack_data_source() :
+            _state(livetrack_state::idle),
             _started(false),
+            _last_start_t(0),
+            _time_to_first_sample(-1),
+            _samples(0),
+            _batches(0),
+            _cpu_duration(0) {}
+        livetrack_data_source(const livetrack_data_source&) = delete;
+        livetrack_data_source(livetrack_data_source&&) = delete;
+        livetrack_data_source& operator=(const livetrack_data_source&) = delete;
+        livetrack_data_source& operator=(livetrack_data_source&&) = delete;
+        virtual ~livetrack_data_source() {}
+
+        /// start enables data acquisition, and returns without waiting for the first sample.
+        /// It throws if the source is not idle.
+        virtual void start() = 0;
+
+        /// stop pauses data acquisition, start can be called again afterwards.
+        /// Stopping an idle source has no effect.
+        virtual void stop() = 0;
+
+        /// state returns the current acquisition state.
+        livetrack_state state() const {
+            return _state.load(std::memory_order_acquire);
+        }
+
+        /// statistics returns the number of samples, batches and CPU time since start was first called.
+        virtual livetrack_statistics statistics() const {
+            return {
+                _samples.load(std::memory_order_acquire),
+                _batches.load(std::memory_order_acquire),
+                std::chrono::nanoseconds(_cpu_duration.load(std::memory_order_acquire)),
+                _started.load(std::memory_order_acquire) ? std::chrono::steady_clock::now() - _start_t :
+                                                           std::chrono::steady_clock::duration(0),
+                std::chrono::nanoseconds(_time_to_first_sample.load(std::memory_order_acquire)),
+            };
+        }
+
+        protected:
+        /// transition changes the state and wakes the threads waiting for it.
+        void transition(livetrack_state state) {
+            {
+                std::lock_guard<std::mutex> lock(_state_mutex);
+                _state.store(state, std::memory_order_release);
+            }
+            _state_changed.notify_all();
+        }
+
+        /// transition changes the state only if it is equal to expected, and returns whether it changed.
+        bool transition(livetrack_state expected, livetrack_state state) {
+            {
+                std::lock_guard<std::mutex> lock(_state_mutex);
+                if (_state.load(std::memory_order_acquire) != expected) {
+                    return false;
+                }
+                _state.store(state, std::memory_order_release);
+            }
+            _state_changed.notify_all();
+            return true;
+        }
+
+        /// wait_for_acquisition blocks while the source is idle, and returns false once it is closing.
+        bool wait_for_acquisition() {
+            std::unique_lock<std::mutex> lock(_state_mutex);
+            _state_changed.wait(
+                lock, [this]() { return _state.load(std::memory_order_acquire) != livetrack_state::idle; });
+            return _state.load(std::memory_order_acquire) != livetrack_state::closing;
+        }
+
+        /// mark_started checks that the source is idle, records the start time and moves to starting.
+        void mark_started() {
+            if (state() != livetrack_state::idle) {
+                throw std::logic_error("the LiveTrack acquisition is already started");
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (!_started.load(std::memory_order_acquire)) {
+                _start_t = now;
+                _started.store(true, std::memory_order_release);
+            }
+            _time_to_first_sample.store(-1, std::memory_order_release);
+            _last_start_t.store(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count(),
+                std::memory_order_release);
+            transition(livetrack_state::starting);
+        }
+
+        /// thread_cpu_time returns the CPU time consumed by the calling thread, in nanoseconds.
+        static uint64_t thread_cpu_time() {
+            timespec cpu_t;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_t);
+            return static_cast<uint64_t>(cpu_t.tv_sec) * 1000000000ull + static_cast<uint64_t>(cpu_t.tv_nsec);
+        }
+
+        /// count adds a batch to the statistics.
+        void count(std::size_t samples, uint64_t cpu_duration) {
+            if (samples > 0) {
+                if (_time_to_first_sample.load(std::memory_order_relaxed) < 0) {
+                    _time_to_first_sample.store(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                                .count()
+                            - _last_start_t.load(std::memory_order_acquire),
+                        std::memory_order_release);
+                }
+                _samples.fetch_add(samples, std::memory_order_release);
+                _batches.fetch_add(1, std::memory_order_release);
+            }
+            _cpu_duration.fetch_add(cpu_duration, std::memory_order_release);
+        }
+
+        std::atomic<livetrack_state> _state;
+        std::mutex _state_mutex;
+        std::condition_variable _state_changed;
+        std::atomic_bool _started;
+        std::chrono::steady_clock::time_point _start_t;
+        std::atomic<int64_t> _last_start_t;
+        std::atomic<int64_t> _time_to_first_sample;
+        std::atomic<uint64_t> _samples;
+        std::atomic<uint64_t> _batches;
+        std::atomic<uint64_t> _cpu_duration;
+    };
+
+    /// livetrack_data_observable handles the connection to a LiveTrack eye tracker.
+    /// Reports are read by a dedicated thread, or by the given reactor's thread if event_loop is not null.
+    /// After start, reports are discarded until the LiveTrack restarts its clock, so that reports left over from
+    /// a previous acquisition are never delivered.
+    /// If logger is not null, the raw reports are appended to it before decoding.
+    /// On each wakeup, the pending reports are drained without blocking.
+    /// If batched is false, the handler is called with each livetrack_data,
+    /// otherwise it is called once per wakeup with a livetrack_data_span.
+    template <typename HandleLivetrackData, typename HandleException, bool batched = false>
+    class livetrack_data_observable : public livetrack_data_source {
+        public:
+        /// batch_capacity is the maximum number of samples passed to a single handler call.
+        static constexpr std::size_t batch_capacity = 256;
+
+        livetrack_data_observable(
+            HandleLivetrackData handle_livetrack_data,
+            HandleException handle_exception,
+            reactor* event_loop = nullptr,
+            livetrack_report_logger* logger = nullptr) :
+            livetrack_data_source(),
+            _event_loop(event_loop),
+            _logger(logger),
             _handle_livetrack_data(std::forward<HandleLivetrackData>(handle_livetrack_data)),
             _handle_exception(std::forward<HandleException>(handle_exception)) {
+            _batch.reserve(batch_capacity);
             _device = hid_open(2145, 13367, nullptr);
             if (_device == nullptr) {
                 throw std::runtime_error("connecting to the LiveTrack failed");
             }
             try {
-                std::array<uint8_t, 64> buffer;
                 write({102}, "stopping the acquisition");
-                for (;;) {
-                    const auto bytes_read = hid_read_timeout(_device, buffer.data(), buffer.size(), 20);
-                    if (bytes_read < 0) {
-                        throw std::runtime_error("reading from the LiveTrack failed");
-                    } else if (bytes_read == 0) {
-                        break;
-                    }
-                }
             } catch (const std::runtime_error& exception) {
                 hid_close(_device);
                 throw exception;
             }
-            _loop = std::thread([&]() {
-                try {
-                    std::array<uint8_t, 64> buffer;
-                    while (_running.load(std::memory_order_acquire)) {
-                        if (_started.load(std::memory_order_acquire)) {
-                            const auto bytes_read = hid_read_timeout(_device, buffer.data(), buffer.size(), 20);
-                            if (bytes_read == 64) {
-                                _handle_livetrack_data(livetrack_data{
-                                    static_cast<uint64_t>(buffer[6]) | (static_cast<uint64_t>(buffer[7]) << 8)
-                                        | (static_cast<uint64_t>(buffer[8]) << 16)
-                                        | (static_cast<uint64_t>(buffer[9]) << 24)
-                                        | (static_cast<uint64_t>(buffer[10]) << 32)
-                                        | (static_cast<uint64_t>(buffer[11]) << 40)
-                                        | (static_cast<uint64_t>(buffer[12]) << 48)
-                                        | (static_cast<uint64_t>(buffer[13]) << 56),
-                                    static_cast<uint32_t>(buffer[2]) | (static_cast<uint32_t>(buffer[3]) << 8)
-                                        | (static_cast<uint32_t>(buffer[4]) << 16)
-                                        | (static_cast<uint32_t>(buffer[5]) << 24),
-                                    {
-                                        static_cast<uint32_t>(buffer[15]) | (static_cast<uint32_t>(buffer[16]) << 8)
-                                            | (static_cast<uint32_t>(buffer[17]) << 16),
-                                        static_cast<uint32_t>(buffer[18]) | (static_cast<uint32_t>(buffer[19]) << 8)
-                                            | (static_cast<uint32_t>(buffer[20]) << 16),
-                                        static_cast<uint32_t>(buffer[21]) | (static_cast<uint32_t>(buffer[22]) << 8)
-                                            | (static_cast<uint32_t>(buffer[23]) << 16),
-                                        static_cast<uint32_t>(buffer[24]) | (static_cast<uint32_t>(buffer[25]) << 8)
-                                            | (static_cast<uint32_t>(buffer[26]) << 16),
-                                        static_cast<uint32_t>(buffer[27]) | (static_cast<uint32_t>(buffer[28]) << 8)
-                                            | (static_cast<uint32_t>(buffer[29]) << 16),
-                                        static_cast<uint32_t>(buffer[30]) | (static_cast<uint32_t>(buffer[31]) << 8)
-                                            | (static_cast<uint32_t>(buffer[32]) << 16),
-                                        static_cast<uint32_t>(buffer[33]) | (static_cast<uint32_t>(buffer[34]) << 8)
-                                            | (static_cast<uint32_t>(buffer[35]) << 16),
-                                        static_cast<uint32_t>(buffer[36]) | (static_cast<uint32_t>(buffer[37]) << 8)
-                                            | (static_cast<uint32_t>(buffer[38]) << 16),
-                                        (buffer[14] & 1) == 1,
-                                        ((buffer[14] >> 1) & 1) == 1,
-                                        ((buffer[14] >> 2) & 1) == 1,
-                                        ((buffer[14] >> 3) & 1) == 1,
-                                    },
-                                    {
-                                        static_cast<uint32_t>(buffer[40]) | (static_cast<uint32_t>(buffer[41]) << 8)
-                                            | (static_cast<uint32_t>(buffer[42]) << 16),
-                                        static_cast<uint32_t>(buffer[43]) | (static_cast<uint32_t>(buffer[44]) << 8)
-                                            | (static_cast<uint32_t>(buffer[45]) << 16),
-                                        static_cast<uint32_t>(buffer[46]) | (static_cast<uint32_t>(buffer[47]) << 8)
-                                            | (static_cast<uint32_t>(buffer[48]) << 16),
-                                        static_cast<uint32_t>(buffer[49]) | (static_cast<uint32_t>(buffer[50]) << 8)
-                                            | (static_cast<uint32_t>(buffer[51]) << 16),
-                                        static_cast<uint32_t>(buffer[52]) | (static_cast<uint32_t>(buffer[53]) << 8)
-                                            | (static_cast<uint32_t>(buffer[54]) << 16),
-                                        static_cast<uint32_t>(buffer[55]) | (static_cast<uint32_t>(buffer[56]) << 8)
-                                            | (static_cast<uint32_t>(buffer[57]) << 16),
-                                        static_cast<uint32_t>(buffer[58]) | (static_cast<uint32_t>(buffer[59]) << 8)
-                                            | (static_cast<uint32_t>(buffer[60]) << 16),
-                                        static_cast<uint32_t>(buffer[61]) | (static_cast<uint32_t>(buffer[62]) << 8)
-                                            | (static_cast<uint32_t>(buffer[63]) << 16),
-                                        (buffer[39] & 1) == 1,
-                                        ((buffer[39] >> 1) & 1) == 1,
-                                        ((buffer[39] >> 2) & 1) == 1,
-                                        ((buffer[39] >> 3) & 1) == 1,
-                                    },
-                                });
-                            } else if (bytes_read < 0) {
-                                throw std::runtime_error("reading from the LiveTrack failed");
-                            }
-
-                        } else {
-                            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            if (!_event_loop) {
+                _loop = std::thread([this]() {
+                    try {
+                        while (wait_for_acquisition()) {
+                            read_reports(20);
                         }
+                    } catch (...) {
+                        _handle_exception(std::current_exception());
                     }
-                } catch (...) {
-                    _handle_exception(std::current_exception());
-                }
-            });
+                });
+            }
         }
         livetrack_data_observable(const livetrack_data_observable&) = delete;
         livetrack_data_observable(livetrack_data_observable&&) = default;
@@ -155,33 +427,103 @@ namespace hibiscus {
                 write({102}, "stopping acquisition");
             } catch (const std::runtime_error&) {
             }
+            if (_event_loop) {
+                _event_loop->remove(hid_get_file_descriptor(_device));
+            }
+            transition(livetrack_state::closing);
+            if (!_event_loop) {
+                _loop.join();
+            }
             hid_close(_device);
-            _running.store(false, std::memory_order_release);
-            _loop.join();
-        }
-
-        /// start enables data acquisition.
-        virtual void start() {
-            std::array<uint8_t, 64> buffer;
-            write({106}, "starting the raw, high-resolution tracking");
-            for (;;) {
-                const auto bytes_read = hid_read_timeout(_device, buffer.data(), buffer.size(), 20);
-                if (bytes_read < 0) {
-                    throw std::runtime_error("reading from the LiveTrack failed");
-                } else if (
-                    bytes_read == 64
-                    && (static_cast<uint64_t>(buffer[6]) | (static_cast<uint64_t>(buffer[7]) << 8)
-                        | (static_cast<uint64_t>(buffer[8]) << 16) | (static_cast<uint64_t>(buffer[9]) << 24)
-                        | (static_cast<uint64_t>(buffer[10]) << 32) | (static_cast<uint64_t>(buffer[11]) << 40)
-                        | (static_cast<uint64_t>(buffer[12]) << 48) | (static_cast<uint64_t>(buffer[13]) << 56))
-                           == 2000) {
-                    break;
-                }
+        }
+
+        virtual void start() override {
+            mark_started();
+            try {
+                write({106}, "starting the raw, high-resolution tracking");
+            } catch (const std::runtime_error&) {
+                transition(livetrack_state::idle);
+                throw;
+            }
+            if (_event_loop) {
+                const auto file_descriptor = hid_get_file_descriptor(_device);
+                _event_loop->add(file_descriptor, [this, file_descriptor]() {
+                    try {
+                        while (read_reports(0)) {
+                        }
+                    } catch (...) {
+                        _event_loop->remove(file_descriptor);
+                        _handle_exception(std::current_exception());
+                    }
+                });
             }
-            _started.store(true, std::memory_order_release);
+        }
+
+        virtual void stop() override {
+            const auto current_state = state();
+            if (current_state == livetrack_state::idle || current_state == livetrack_state::closing) {
+                return;
+            }
+            if (_event_loop) {
+                _event_loop->remove(hid_get_file_descriptor(_device));
+            }
+            transition(livetrack_state::idle);
+            write({102}, "stopping the acquisition");
         }
 
         protected:
+        /// read_reports waits at most timeout milliseconds for a report, reads the pending reports without blocking,
+        /// and dispatches the decoded samples.
+        /// false is returned if no report was available.
+        virtual bool read_reports(int32_t timeout) {
+            const auto cpu_begin = thread_cpu_time();
+            _batch.clear();
+            auto report_read = read_report(timeout);
+            for (auto read = report_read; read && _batch.size() < batch_capacity;) {
+                read = read_report(0);
+            }
+            if (!_batch.empty()) {
+                dispatch(std::integral_constant<bool, batched>());
+            }
+            count(_batch.size(), thread_cpu_time() - cpu_begin);
+            return report_read;
+        }
+
+        /// dispatch calls the handler with each sample in the batch.
+        void dispatch(std::false_type) {
+            for (const auto& livetrack_data : _batch) {
+                _handle_livetrack_data(livetrack_data);
+            }
+        }
+
+        /// dispatch calls the handler with the batch.
+        void dispatch(std::true_type) {
+            _handle_livetrack_data(livetrack_data_span(_batch.data(), _batch.data() + _batch.size()));
+        }
+
+        /// read_report waits at most timeout milliseconds for a report, and appends its sample to the batch.
+        /// While starting, reports are discarded until the first report of the new acquisition (timestamp 2000).
+        /// false is returned if no report was available.
+        virtual bool read_report(int32_t timeout) {
+            const auto bytes_read = hid_read_timeout(_device, _buffer.data(), _buffer.size(), timeout);
+            if (bytes_read < 0) {
+                throw std::runtime_error("reading from the LiveTrack failed");
+            }
+            if (bytes_read == 64) {
+                if (state() == livetrack_state::starting) {
+                    if (report_to_livetrack_data(_buffer.data()).t == 2000) {
+                        transition(livetrack_state::starting, livetrack_state::running);
+                    }
+                    return true;
+                }
+                if (_logger) {
+                    _logger->append(_buffer.data(), std::chrono::steady_clock::now());
+                }
+                _batch.push_back(report_to_livetrack_data(_buffer.data()));
+            }
+            return bytes_read > 0;
+        }
+
         /// write sends a message to the LiveTrack.
         virtual void write(const std::array<uint8_t, 64>& buffer, const std::string& name) {
             if (hid_write(_device, buffer.data(), buffer.size()) != buffer.size()) {
@@ -189,10 +531,12 @@ namespace hibiscus {
             }
         }
 
-        std::atomic_bool _running;
-        std::atomic_bool _started;
+        reactor* _event_loop;
+        livetrack_report_logger* _logger;
         std::thread _loop;
         hid_device* _device;
+        std::array<uint8_t, 64> _buffer;
+        std::vector<livetrack_data> _batch;
         HandleLivetrackData _handle_livetrack_data;
         HandleException _handle_exception;
     };
@@ -201,10 +545,33 @@ namespace hibiscus {
     /// functors.
     template <typename HandleLivetrackData, typename HandleException>
     std::unique_ptr<livetrack_data_observable<HandleLivetrackData, HandleException>>
-    make_livetrack_data_observable(HandleLivetrackData handle_livetrack_data, HandleException handle_exception) {
+    make_livetrack_data_observable(
+        HandleLivetrackData handle_livetrack_data,
+        HandleException handle_exception,
+        reactor* event_loop = nullptr,
+        livetrack_report_logger* logger = nullptr) {
         return std::unique_ptr<livetrack_data_observable<HandleLivetrackData, HandleException>>(
             new livetrack_data_observable<HandleLivetrackData, HandleException>(
                 std::forward<HandleLivetrackData>(handle_livetrack_data),
-                std::forward<HandleException>(handle_exception)));
+                std::forward<HandleException>(handle_exception),
+                event_loop,
+                logger));
+    }
+
+    /// make_livetrack_data_batch_observable creates a livetrack_data_observable from functors,
+    /// which passes the samples read on each wakeup to handle_livetrack_data_span.
+    template <typename HandleLivetrackDataSpan, typename HandleException>
+    std::unique_ptr<livetrack_data_observable<HandleLivetrackDataSpan, HandleException, true>>
+    make_livetrack_data_batch_observable(
+        HandleLivetrackDataSpan handle_livetrack_data_span,
+        HandleException handle_exception,
+        reactor* event_loop = nullptr,
+        livetrack_report_logger* logger = nullptr) {
+        return std::unique_ptr<livetrack_data_observable<HandleLivetrackDataSpan, HandleException, true>>(
+            new livetrack_data_observable<HandleLivetrackDataSpan, HandleException, true>(
+                std::forward<HandleLivetrackDataSpan>(handle_livetrack_data_span),
+                std::forward<HandleException>(handle_exception),
+                event_loop,
+                logger));
     }
 }
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "livetrack_data_observable.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// livetrack_replay_observable reads LiveTrack samples from a file, and delivers them like a
+    /// livetrack_data_observable, so that the gaze pipeline can run without the eye tracker.
+    /// The file contains either raw 64-bytes reports, a livetrack_report_logger log (detected by its header),
+    /// or a calibrate dump (detected by the .csv extension).
+    /// A calibrate dump only has the pupils and the first glints: the axes, the second glints and io are set to zero,
+    /// and the flags are set as if both eyes were tracked.
+    /// Samples are delivered at the recorded pace multiplied by speed, or as fast as possible if speed is zero.
+    /// The replay stops at the end of the file, and stop pauses it until the next start.
+    template <typename HandleLivetrackData, typename HandleException, bool batched = false>
+    class livetrack_replay_observable : public livetrack_data_source {
+        public:
+        /// batch_capacity is the maximum number of samples passed to a single handler call.
+        static constexpr std::size_t batch_capacity = 256;
+
+        livetrack_replay_observable(
+            const std::string& filename,
+            double speed,
+            HandleLivetrackData handle_livetrack_data,
+            HandleException handle_exception) :
+            livetrack_data_source(),
+            _speed(speed),
+            _csv(filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0),
+            _logged(false),
+            _input(filename, std::ifstream::binary),
+            _handle_livetrack_data(std::forward<HandleLivetrackData>(handle_livetrack_data)),
+            _handle_exception(std::forward<HandleException>(handle_exception)) {
+            if (!_input.good()) {
+                throw std::runtime_error(std::string("'") + filename + "' could not be open for reading");
+            }
+            if (_speed < 0) {
+                throw std::runtime_error("the replay speed must be positive or zero");
+            }
+            if (!_csv) {
+                std::array<char, livetrack_log_layout::record_size> header;
+                _logged = _input.read(header.data(), header.size())
+                          && std::equal(
+                              header.begin(),
+                              std::next(header.begin(), sizeof(livetrack_log_layout::signature) - 1),
+                              livetrack_log_layout::signature);
+                if (!_logged) {
+                    _input.clear();
+                    _input.seekg(0);
+                }
+            }
+            _batch.reserve(batch_capacity);
+            _loop = std::thread([this]() {
+                try {
+                    livetrack_data next_livetrack_data;
+                    auto available = read(next_livetrack_data);
+                    while (available && wait_for_acquisition()) {
+                        transition(livetrack_state::starting, livetrack_state::running);
+                        // the pacing restarts after each start
+                        const auto first_t = next_livetrack_data.t;
+                        const auto start_t = std::chrono::steady_clock::now();
+                        auto due = [&](uint64_t t) {
+                            return start_t
+                                   + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double, std::micro>((t - first_t) / _speed));
+                        };
+                        while (available && state() == livetrack_state::running) {
+                            if (_speed > 0) {
+                                std::unique_lock<std::mutex> lock(_state_mutex);
+                                if (_state_changed.wait_until(lock, due(next_livetrack_data.t), [this]() {
+                                        return _state.load(std::memory_order_acquire) != livetrack_state::running;
+                                    })) {
+                                    break;
+                                }
+                            }
+                            const auto cpu_begin = thread_cpu_time();
+                            const auto now = std::chrono::steady_clock::now();
+                            _batch.clear();
+                            while (available && _batch.size() < batch_capacity
+                                   && (_speed == 0 || due(next_livetrack_data.t) <= now)) {
+                                _batch.push_back(next_livetrack_data);
+                                available = read(next_livetrack_data);
+                            }
+                            if (!_batch.empty()) {
+                                dispatch(std::integral_constant<bool, batched>());
+                            }
+                            count(_batch.size(), thread_cpu_time() - cpu_begin);
+                        }
+                    }
+                } catch (...) {
+                    _handle_exception(std::current_exception());
+                }
+            });
+        }
+        livetrack_replay_observable(const livetrack_replay_observable&) = delete;
+        livetrack_replay_observable(livetrack_replay_observable&&) = default;
+        livetrack_replay_observable& operator=(const livetrack_replay_observable&) = delete;
+        livetrack_replay_observable& operator=(livetrack_replay_observable&&) = default;
+        virtual ~livetrack_replay_observable() {
+            transition(livetrack_state::closing);
+            _loop.join();
+        }
+
+        virtual void start() override {
+            mark_started();
+        }
+
+        virtual void stop() override {
+            if (!transition(livetrack_state::running, livetrack_state::idle)) {
+                transition(livetrack_state::starting, livetrack_state::idle);
+            }
+        }
+
+        protected:
+        /// read decodes the next sample, and returns false at the end of the file.
+        virtual bool read(livetrack_data& livetrack_data) {
+            if (_csv) {
+                std::string line;
+                while (std::getline(_input, line)) {
+                    // the header starts with 't' and the fixation markers with -1
+                    if (line.empty() || line[0] == 't' || line[0] == '-') {
+                        continue;
+                    }
+                    std::stringstream stream(line);
+                    std::array<uint64_t, 9> values;
+                    for (auto& value : values) {
+                        if (!(stream >> value)) {
+                            throw std::runtime_error(std::string("parsing the line '") + line + "' failed");
+                        }
+                        stream.ignore(1);
+                    }
+                    livetrack_data = {
+                        values[0],
+                        0,
+                        {0,
+                         0,
+                         static_cast<uint32_t>(values[1]),
+                         static_cast<uint32_t>(values[2]),
+                         static_cast<uint32_t>(values[3]),
+                         static_cast<uint32_t>(values[4]),
+                         0,
+                         0,
+                         true,
+                         true,
+                         true,
+                         false},
+                        {0,
+                         0,
+                         static_cast<uint32_t>(values[5]),
+                         static_cast<uint32_t>(values[6]),
+                         static_cast<uint32_t>(values[7]),
+                         static_cast<uint32_t>(values[8]),
+                         0,
+                         0,
+                         true,
+                         true,
+                         true,
+                         false},
+                    };
+                    return true;
+                }
+                return false;
+            }
+            if (_logged) {
+                std::array<uint8_t, livetrack_log_layout::timestamp_size> timestamp;
+                if (!_input.read(reinterpret_cast<char*>(timestamp.data()), timestamp.size())
+                    || std::all_of(timestamp.begin(), timestamp.end(), [](uint8_t byte) { return byte == 0; })) {
+                    return false;
+                }
+            }
+            if (!_input.read(reinterpret_cast<char*>(_report.data()), _report.size())) {
+                return false;
+            }
+            livetrack_data = report_to_livetrack_data(_report.data());
+            return true;
+        }
+
+        /// dispatch calls the handler with each sample in the batch.
+        void dispatch(std::false_type) {
+            for (const auto& livetrack_data : _batch) {
+                _handle_livetrack_data(livetrack_data);
+            }
+        }
+
+        /// dispatch calls the handler with the batch.
+        void dispatch(std::true_type) {
+            _handle_livetrack_data(livetrack_data_span(_batch.data(), _batch.data() + _batch.size()));
+        }
+
+        const double _speed;
+        const bool _csv;
+        bool _logged;
+        std::ifstream _input;
+        std::thread _loop;
+        std::array<uint8_t, livetrack_report_layout::size> _report;
+        std::vector<livetrack_data> _batch;
+        HandleLivetrackData _handle_livetrack_data;
+        HandleException _handle_exception;
+    };
+
+    /// make_livetrack_data_source creates a livetrack_data_observable connected to the LiveTrack if
+    /// replay_filename is empty, and a livetrack_replay_observable reading the given file otherwise.
+    /// logger only records the reports of a connected LiveTrack.
+    template <typename HandleLivetrackData, typename HandleException>
+    std::unique_ptr<livetrack_data_source> make_livetrack_data_source(
+        HandleLivetrackData handle_livetrack_data,
+        HandleException handle_exception,
+        reactor* event_loop = nullptr,
+        const std::string& replay_filename = std::string(),
+        double replay_speed = 1.0,
+        livetrack_report_logger* logger = nullptr) {
+        if (replay_filename.empty()) {
+            return std::unique_ptr<livetrack_data_source>(
+                new livetrack_data_observable<HandleLivetrackData, HandleException>(
+                    std::forward<HandleLivetrackData>(handle_livetrack_data),
+                    std::forward<HandleException>(handle_exception),
+                    event_loop,
+                    logger));
+        }
+        return std::unique_ptr<livetrack_data_source>(
+            new livetrack_replay_observable<HandleLivetrackData, HandleException>(
+                replay_filename,
+                replay_speed,
+                std::forward<HandleLivetrackData>(handle_livetrack_data),
+                std::forward<HandleException>(handle_exception)));
+    }
+
+    /// make_livetrack_data_batch_source is the batched version of make_livetrack_data_source,
+    /// handle_livetrack_data_span is called with a livetrack_data_span.
+    template <typename HandleLivetrackDataSpan, typename HandleException>
+    std::unique_ptr<livetrack_data_source> make_livetrack_data_batch_source(
+        HandleLivetrackDataSpan handle_livetrack_data_span,
+        HandleException handle_exception,
+        reactor* event_loop = nullptr,
+        const std::string& replay_filename = std::string(),
+        double replay_speed = 1.0,
+        livetrack_report_logger* logger = nullptr) {
+        if (replay_filename.empty()) {
+            return std::unique_ptr<livetrack_data_source>(
+                new livetrack_data_observable<HandleLivetrackDataSpan, HandleException, true>(
+                    std::forward<HandleLivetrackDataSpan>(handle_livetrack_data_span),
+                    std::forward<HandleException>(handle_exception),
+                    event_loop,
+                    logger));
+        }
+        return std::unique_ptr<livetrack_data_source>(
+            new livetrack_replay_observable<HandleLivetrackDataSpan, HandleException, true>(
+                replay_filename,
+                replay_speed,
+                std::forward<HandleLivetrackDataSpan>(handle_livetrack_data_span),
+                std::forward<HandleException>(handle_exception)));
+    }
+}
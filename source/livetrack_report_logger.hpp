@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// livetrack_log_layout describes the raw LiveTrack log format.
+    /// The file starts with a header record, followed by one record per report.
+    /// A record contains the host reception timestamp (steady clock nanoseconds, little endian)
+    /// followed by the untouched 64-bytes report.
+    /// A record with a zero timestamp marks the end of a log which was not closed properly.
+    namespace livetrack_log_layout {
+        constexpr std::size_t timestamp_size = 8;
+        constexpr std::size_t report_size = 64;
+        constexpr std::size_t record_size = timestamp_size + report_size;
+        constexpr char signature[] = "hibiscus livetrack reports";
+    }
+
+    /// livetrack_report_logger appends raw LiveTrack reports to a memory-mapped file.
+    /// The file grows by preallocated segments, mapped and faulted in ahead of time by a background thread.
+    /// The same thread flushes the completely written pages, so that append only copies the report.
+    /// append must always be called from the same thread.
+    /// If the next segment is not ready when the current one is full, reports are dropped rather than waited for.
+    class livetrack_report_logger {
+        public:
+        /// records_per_segment is a multiple of 512 so that segment offsets are aligned on page boundaries.
+        static constexpr std::size_t records_per_segment = 1 << 16;
+
+        /// segment_size is the size of a mapped segment in bytes.
+        static constexpr std::size_t segment_size = records_per_segment * livetrack_log_layout::record_size;
+
+        livetrack_report_logger(
+            const std::string& filename,
+            std::chrono::milliseconds flush_period = std::chrono::milliseconds(100)) :
+            _filename(filename),
+            _flush_period(flush_period),
+            _page_size(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+            _segments(0),
+            _segment(nullptr),
+            _segment_index(0),
+            _index(1),
+            _records(0),
+            _written(livetrack_log_layout::record_size),
+            _dropped(0),
+            _next(nullptr),
+            _retired(nullptr),
+            _running(true) {
+            _file_descriptor = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (_file_descriptor < 0) {
+                throw std::runtime_error(std::string("'") + filename + "' could not be open for writing");
+            }
+            try {
+                _segment = map_segment();
+                std::copy_n(
+                    livetrack_log_layout::signature, sizeof(livetrack_log_layout::signature) - 1, _segment);
+                _next.store(map_segment(), std::memory_order_release);
+            } catch (const std::runtime_error&) {
+                if (_segment) {
+                    munmap(_segment, segment_size);
+                }
+                close(_file_descriptor);
+                throw;
+            }
+            _flusher = std::thread([this]() {
+                // the flusher tracks the segment being written, which changes whenever a segment is retired
+                auto current = _segment;
+                auto pending = _next.load(std::memory_order_acquire);
+                std::size_t current_offset = 0;
+                std::size_t flushed = 0;
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (_running.load(std::memory_order_acquire)) {
+                    _condition_variable.wait_for(lock, _flush_period);
+                    const auto retired = _retired.exchange(nullptr, std::memory_order_acq_rel);
+                    if (retired) {
+                        msync(retired + flushed, segment_size - flushed, MS_SYNC);
+                        munmap(retired, segment_size);
+                        current = pending;
+                        pending = nullptr;
+                        current_offset += segment_size;
+                        flushed = 0;
+                    }
+                    // pages are flushed once complete, since a flushed page faults on the next write
+                    const auto written = std::min(
+                        static_cast<std::size_t>(_written.load(std::memory_order_acquire)) - current_offset,
+                        segment_size);
+                    const auto complete = written - written % _page_size;
+                    if (complete > flushed) {
+                        msync(current + flushed, complete - flushed, MS_SYNC);
+                        flushed = complete;
+                    }
+                    if (!pending) {
+                        try {
+                            pending = map_segment();
+                            _next.store(pending, std::memory_order_release);
+                        } catch (const std::runtime_error&) {
+                            // the following reports are dropped until a segment can be mapped
+                        }
+                    }
+                }
+            });
+        }
+        livetrack_report_logger(const livetrack_report_logger&) = delete;
+        livetrack_report_logger(livetrack_report_logger&&) = delete;
+        livetrack_report_logger& operator=(const livetrack_report_logger&) = delete;
+        livetrack_report_logger& operator=(livetrack_report_logger&&) = delete;
+        virtual ~livetrack_report_logger() {
+            _running.store(false, std::memory_order_release);
+            _condition_variable.notify_one();
+            _flusher.join();
+            for (auto segment : {_retired.load(std::memory_order_acquire), _next.load(std::memory_order_acquire)}) {
+                if (segment) {
+                    munmap(segment, segment_size);
+                }
+            }
+            msync(_segment, segment_size, MS_SYNC);
+            munmap(_segment, segment_size);
+            if (ftruncate(
+                    _file_descriptor,
+                    static_cast<off_t>(_segment_index * segment_size + _index * livetrack_log_layout::record_size))
+                < 0) {
+                // the log stays readable, since it ends with zeros
+            }
+            close(_file_descriptor);
+        }
+
+        /// append copies a report and its reception time to the log.
+        void append(const uint8_t* report, std::chrono::steady_clock::time_point t) {
+            if (_index == records_per_segment) {
+                const auto next = _next.exchange(nullptr, std::memory_order_acq_rel);
+                if (!next) {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                _retired.store(_segment, std::memory_order_release);
+                _segment = next;
+                ++_segment_index;
+                _index = 0;
+                _condition_variable.notify_one();
+            }
+            auto record = _segment + _index * livetrack_log_layout::record_size;
+            const auto timestamp = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+            for (std::size_t index = 0; index < livetrack_log_layout::timestamp_size; ++index) {
+                record[index] = static_cast<uint8_t>((timestamp >> (8 * index)) & 0xff);
+            }
+            std::memcpy(record + livetrack_log_layout::timestamp_size, report, livetrack_log_layout::report_size);
+            ++_index;
+            _records.fetch_add(1, std::memory_order_release);
+            _written.store(
+                _segment_index * segment_size + _index * livetrack_log_layout::record_size, std::memory_order_release);
+        }
+
+        /// records returns the number of logged reports.
+        uint64_t records() const {
+            return _records.load(std::memory_order_acquire);
+        }
+
+        /// dropped returns the number of reports lost because the next segment was not ready.
+        uint64_t dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+
+        protected:
+        /// map_segment preallocates the next segment on disk, maps it, and writes to each page
+        /// so that append does not trigger page faults.
+        virtual uint8_t* map_segment() {
+            const auto offset = static_cast<off_t>(_segments * segment_size);
+            if (posix_fallocate(_file_descriptor, offset, static_cast<off_t>(segment_size)) != 0) {
+                throw std::runtime_error(std::string("preallocating '") + _filename + "' failed");
+            }
+            const auto segment = mmap(
+                nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _file_descriptor, offset);
+            if (segment == MAP_FAILED) {
+                throw std::runtime_error(std::string("mapping '") + _filename + "' failed");
+            }
+            ++_segments;
+            const auto bytes = reinterpret_cast<uint8_t*>(segment);
+            for (std::size_t index = 0; index < segment_size; index += _page_size) {
+                reinterpret_cast<volatile uint8_t*>(bytes)[index] = 0;
+            }
+            return bytes;
+        }
+
+        const std::string _filename;
+        const std::chrono::milliseconds _flush_period;
+        int32_t _file_descriptor;
+        const std::size_t _page_size;
+        std::size_t _segments;
+        uint8_t* _segment;
+        std::size_t _segment_index;
+        std::size_t _index;
+        std::atomic<uint64_t> _records;
+        std::atomic<uint64_t> _written;
+        std::atomic<uint64_t> _dropped;
+        std::atomic<uint8_t*> _next;
+        std::atomic<uint8_t*> _retired;
+        std::atomic_bool _running;
+        std::mutex _mutex;
+        std::condition_variable _condition_variable;
+        std::thread _flusher;
+    };
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "spsc_queue.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// livetrack_video_layout describes the LiveTrack video files.
+    /// The video file contains the untouched MJPEG frames one after the other, which is a raw MJPEG stream
+    /// (for example, ffmpeg reads it with -f mjpeg).
+    /// The index file (same name with the index_extension suffix) starts with a header record, followed by one
+    /// record per frame: the frame offset in the video file (uint64), the frame size (uint32), the capture time
+    /// (steady clock nanoseconds, uint64) and the capture time on the Teensy timeline (microseconds, uint64,
+    /// no_teensy_t if unknown), in little endian.
+    namespace livetrack_video_layout {
+        constexpr std::size_t index_record_size = 28;
+        constexpr char index_signature[] = "hibiscus livetrack video";
+        constexpr char index_extension[] = ".index";
+        constexpr uint64_t no_teensy_t = std::numeric_limits<uint64_t>::max();
+    }
+
+    /// livetrack_video_logger writes LiveTrack MJPEG frames to disk without re-encoding them.
+    /// append copies the frame to a preallocated slot, and a background thread writes the slots to the files,
+    /// so that the capture thread never waits for the disk.
+    /// If every slot is waiting to be written, frames are dropped rather than waited for.
+    /// host_to_teensy converts capture times to the Teensy timeline, and is called by the background thread.
+    /// append must always be called from the same thread.
+    class livetrack_video_logger {
+        public:
+        livetrack_video_logger(
+            const std::string& filename,
+            std::function<uint64_t(std::chrono::steady_clock::time_point)> host_to_teensy = nullptr,
+            std::size_t slots = 64) :
+            _filename(filename),
+            _host_to_teensy(std::move(host_to_teensy)),
+            _slots(slots),
+            _free_slots(slots),
+            _pending_slots(slots),
+            _frames(0),
+            _dropped(0),
+            _failed(false),
+            _running(true) {
+            _video.open(filename, std::ofstream::binary | std::ofstream::trunc);
+            if (!_video.good()) {
+                throw std::runtime_error(std::string("'") + filename + "' could not be open for writing");
+            }
+            const auto index_filename = filename + livetrack_video_layout::index_extension;
+            _index.open(index_filename, std::ofstream::binary | std::ofstream::trunc);
+            if (!_index.good()) {
+                throw std::runtime_error(std::string("'") + index_filename + "' could not be open for writing");
+            }
+            {
+                std::vector<char> header(livetrack_video_layout::index_record_size, 0);
+                std::copy_n(
+                    livetrack_video_layout::index_signature,
+                    sizeof(livetrack_video_layout::index_signature) - 1,
+                    header.begin());
+                _index.write(header.data(), header.size());
+            }
+            for (std::size_t index = 0; index < _slots.size(); ++index) {
+                // MJPEG frames are a few tens of kilobytes, larger frames grow the slot
+                _slots[index].bytes.resize(1 << 17);
+                _free_slots.push(index);
+            }
+            _writer = std::thread([this]() {
+                uint64_t offset = 0;
+                std::array<char, livetrack_video_layout::index_record_size> record;
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (;;) {
+                    std::size_t index;
+                    if (!_pending_slots.pull(index)) {
+                        if (!_running.load(std::memory_order_acquire)) {
+                            break;
+                        }
+                        _condition_variable.wait_for(lock, std::chrono::milliseconds(20));
+                        continue;
+                    }
+                    const auto& current_slot = _slots[index];
+                    const auto t = static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(current_slot.t.time_since_epoch())
+                            .count());
+                    const auto teensy_t =
+                        _host_to_teensy ? _host_to_teensy(current_slot.t) : livetrack_video_layout::no_teensy_t;
+                    std::size_t record_index = 0;
+                    for (const auto& value_and_size : {std::make_pair(offset, 8),
+                                                       std::make_pair(static_cast<uint64_t>(current_slot.size), 4),
+                                                       std::make_pair(t, 8),
+                                                       std::make_pair(teensy_t, 8)}) {
+                        for (int32_t byte_index = 0; byte_index < value_and_size.second; ++byte_index) {
+                            record[record_index] = static_cast<char>((value_and_size.first >> (8 * byte_index)) & 0xff);
+                            ++record_index;
+                        }
+                    }
+                    _video.write(reinterpret_cast<const char*>(current_slot.bytes.data()), current_slot.size);
+                    _index.write(record.data(), record.size());
+                    offset += current_slot.size;
+                    _free_slots.push(index);
+                    if (!_video.good() || !_index.good()) {
+                        _failed.store(true, std::memory_order_release);
+                    }
+                }
+                _video.flush();
+                _index.flush();
+            });
+        }
+        livetrack_video_logger(const livetrack_video_logger&) = delete;
+        livetrack_video_logger(livetrack_video_logger&&) = delete;
+        livetrack_video_logger& operator=(const livetrack_video_logger&) = delete;
+        livetrack_video_logger& operator=(livetrack_video_logger&&) = delete;
+        virtual ~livetrack_video_logger() {
+            _running.store(false, std::memory_order_release);
+            _condition_variable.notify_one();
+            _writer.join();
+        }
+
+        /// append copies an encoded frame and its capture time to a slot, and hands it over to the writer.
+        void append(const uint8_t* bytes, std::size_t size, std::chrono::steady_clock::time_point t) {
+            if (_failed.load(std::memory_order_acquire)) {
+                throw std::runtime_error(std::string("writing '") + _filename + "' failed");
+            }
+            std::size_t index;
+            if (!_free_slots.pull(index)) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            auto& current_slot = _slots[index];
+            if (current_slot.bytes.size() < size) {
+                current_slot.bytes.resize(size);
+            }
+            std::copy_n(bytes, size, current_slot.bytes.begin());
+            current_slot.size = size;
+            current_slot.t = t;
+            _pending_slots.push(index);
+            _frames.fetch_add(1, std::memory_order_relaxed);
+            _condition_variable.notify_one();
+        }
+
+        /// frames returns the number of frames handed over to the writer.
+        uint64_t frames() const {
+            return _frames.load(std::memory_order_relaxed);
+        }
+
+        /// dropped returns the number of frames lost because every slot was waiting to be written.
+        uint64_t dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+
+        protected:
+        /// slot holds a frame waiting to be written.
+        struct slot {
+            std::vector<uint8_t> bytes;
+            std::size_t size;
+            std::chrono::steady_clock::time_point t;
+        };
+
+        const std::string _filename;
+        std::function<uint64_t(std::chrono::steady_clock::time_point)> _host_to_teensy;
+        std::ofstream _video;
+        std::ofstream _index;
+        std::vector<slot> _slots;
+        spsc_queue<std::size_t> _free_slots;
+        spsc_queue<std::size_t> _pending_slots;
+        std::atomic<uint64_t> _frames;
+        std::atomic<uint64_t> _dropped;
+        std::atomic_bool _failed;
+        std::atomic_bool _running;
+        std::mutex _mutex;
+        std::condition_variable _condition_variable;
+        std::thread _writer;
+    };
+}
@@ -1,10 +1,21 @@
 #pragma once
 
+#include "latency_histogram.hpp"
+#include "livetrack_video_logger.hpp"
+#include "reactor.hpp"
+#include "triple_buffer.hpp"
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <fcntl.h>
 #include <jpeglib.h>
 #include <libv4l2.h>
 #include <linux/videodev2.h>
+#include <mutex>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
 #include <thread>
@@ -12,17 +23,68 @@
 
 /// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
 namespace hibiscus {
+    /// livetrack_video_region is a rectangle in full-resolution frame coordinates.
+    struct livetrack_video_region {
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    /// livetrack_video_output configures the frames decoded by a livetrack_video_observable.
+    struct livetrack_video_output {
+        /// minimum_width and minimum_height bound the decoded frame size.
+        /// The decoder uses the largest DCT scaling (1/1, 1/2, 1/4 or 1/8) which preserves these dimensions,
+        /// so that smaller frames are cheaper to decode.
+        uint16_t minimum_width = 1280;
+        uint16_t minimum_height = 280;
+
+        /// grayscale decodes frames with a single channel instead of RGB.
+        /// The LiveTrack camera is infrared, hence its frames are effectively monochrome.
+        bool grayscale = false;
+
+        /// regions restricts decoding to the given rectangles, at full resolution (the minimum size is ignored).
+        /// Decoded frames then contain each region's pixels in turn (see livetrack_video_observable::region_offset).
+        /// With libjpeg-turbo, the columns outside the regions are not transformed and the rows above them are
+        /// skipped, otherwise the rows above are decoded and discarded. Rows below the regions are never decoded.
+        std::vector<livetrack_video_region> regions;
+
+        /// decode can be set to false to only record the frames with a livetrack_video_logger.
+        /// The frame handler is then never called.
+        bool decode = true;
+    };
+
     /// livetrack_video_observable retrieves frames from a LiveTrack.
+    /// Frames are captured by a dedicated thread, or by the given reactor's thread if event_loop is not null,
+    /// and handed over to a decoding thread which always decodes the latest frame. Frames captured while the decoder
+    /// is busy replace the pending one, so that a slow decode or handler does not delay the following frames.
+    /// If buffers is larger than zero and the driver supports streaming, frames are copied from buffers
+    /// mapped from the kernel, which are given back immediately. Otherwise, frames are copied with read.
+    /// If logger is not null, the capture thread appends every encoded frame to it.
+    /// The frame handler is called with the decoded bytes (width() x height() pixels with components() channels,
+    /// or the regions' pixels if any) and the capture time, measured by the driver when streaming and on reception
+    /// otherwise.
     template <typename HandleFrame, typename HandleException>
     class livetrack_video_observable {
         public:
         livetrack_video_observable(
             const std::string& source,
             HandleFrame handle_frame,
-            HandleException handle_exception) :
+            HandleException handle_exception,
+            reactor* event_loop = nullptr,
+            std::size_t buffers = 4,
+            livetrack_video_output output = {},
+            livetrack_video_logger* logger = nullptr) :
             _handle_frame(std::forward<HandleFrame>(handle_frame)),
             _handle_exception(std::forward<HandleException>(handle_exception)),
-            _running(true) {
+            _event_loop(event_loop),
+            _running(true),
+            _decode(output.decode),
+            _logger(logger),
+            _requested_buffers(false),
+            _captured(0),
+            _decoded(0),
+            _dropped(0) {
             _file_descriptor = v4l2_open(source.c_str(), O_RDWR);
             if (_file_descriptor < 0) {
                 throw std::runtime_error(std::string("opening '") + source + "' failed");
@@ -51,51 +113,115 @@ namespace hibiscus {
                     v4l2_close(_file_descriptor);
                     throw std::runtime_error("unexpected LiveTrack frame size");
                 }
-                _bytes.resize(frame_size.discrete.width * frame_size.discrete.height * 3);
-                _encoded_bytes.resize(_bytes.size());
-            }
-            _loop = std::thread([this]() {
-                jpeg_decompress_struct decompress_information;
-                jpeg_create_decompress(&decompress_information);
-                jpeg_error_mgr error_message;
-                decompress_information.err = jpeg_std_error(&error_message);
-                error_message.error_exit = [](j_common_ptr information) {
-                    char message[JMSG_LENGTH_MAX];
-                    (*(information->err->format_message))(information, message);
-                    throw std::runtime_error(message);
-                };
-                decompress_information.do_fancy_upsampling = false;
+                _scale_denominator = output.regions.empty() ? 8 : 1;
+                while (_scale_denominator > 1
+                       && ((frame_size.discrete.width + _scale_denominator - 1) / _scale_denominator
+                               < output.minimum_width
+                           || (frame_size.discrete.height + _scale_denominator - 1) / _scale_denominator
+                                  < output.minimum_height)) {
+                    _scale_denominator /= 2;
+                }
+                _width = (frame_size.discrete.width + _scale_denominator - 1) / _scale_denominator;
+                _height = (frame_size.discrete.height + _scale_denominator - 1) / _scale_denominator;
+                _grayscale = output.grayscale;
+                _regions = output.regions;
+                if (_regions.empty()) {
+                    _bytes.resize(_width * _height * components());
+                    for (std::size_t y = 0; y < _height; ++y) {
+                        _rows.push_back(_bytes.data() + y * _width * components());
+                    }
+                } else {
+                    _regions_x_begin = _width;
+                    _regions_x_end = 0;
+                    _regions_y_begin = _height;
+                    _regions_y_end = 0;
+                    std::size_t size = 0;
+                    for (const auto& region : _regions) {
+                        if (region.width == 0 || region.height == 0 || region.x + region.width > _width
+                            || region.y + region.height > _height) {
+                            v4l2_close(_file_descriptor);
+                            throw std::runtime_error("a LiveTrack region is empty or outside the frame");
+                        }
+                        _regions_x_begin = std::min(_regions_x_begin, static_cast<std::size_t>(region.x));
+                        _regions_x_end = std::max(_regions_x_end, static_cast<std::size_t>(region.x + region.width));
+                        _regions_y_begin = std::min(_regions_y_begin, static_cast<std::size_t>(region.y));
+                        _regions_y_end = std::max(_regions_y_end, static_cast<std::size_t>(region.y + region.height));
+                        _region_offsets.push_back(size);
+                        size += region.width * region.height * components();
+                    }
+                    _bytes.resize(size);
+                    // the strip spans whole rows, since the decoder may widen the cropped columns to block boundaries
+                    _strip.resize((_regions_y_end - _regions_y_begin) * _width * components());
+                    for (std::size_t y = _regions_y_begin; y < _regions_y_end; ++y) {
+                        _rows.push_back(_strip.data() + (y - _regions_y_begin) * _width * components());
+                    }
+                }
+                _raw_frame_size = frame_size.discrete.width * frame_size.discrete.height * 3;
+            }
+            if (buffers > 0) {
                 try {
-                    pollfd poll_file_descriptor;
-                    poll_file_descriptor.fd = _file_descriptor;
-                    poll_file_descriptor.events = POLLIN;
-                    while (_running.load(std::memory_order_acquire)) {
-                        const auto poll_result = poll(&poll_file_descriptor, 1, 25);
-                        if (poll_result < 0) {
-                            throw std::runtime_error("poll LiveTrack failed");
+                    start_streaming(buffers);
+                } catch (const std::runtime_error&) {
+                    stop_streaming();
+                    v4l2_close(_file_descriptor);
+                    throw;
+                }
+            }
+            jpeg_create_decompress(&_decompress_information);
+            _decompress_information.err = jpeg_std_error(&_error_message);
+            _error_message.error_exit = [](j_common_ptr information) {
+                char message[JMSG_LENGTH_MAX];
+                (*(information->err->format_message))(information, message);
+                throw std::runtime_error(message);
+            };
+            if (_decode) {
+                _decoder = std::thread([this]() {
+                    try {
+                        while (_running.load(std::memory_order_acquire)) {
+                            {
+                                std::unique_lock<std::mutex> lock(_mutex);
+                                _condition_variable.wait_for(lock, std::chrono::milliseconds(25), [this]() {
+                                    return _frames.has_new() || !_running.load(std::memory_order_acquire);
+                                });
+                            }
+                            if (_frames.acquire()) {
+                                decode_frame(_frames.front());
+                            }
                         }
-                        if (poll_result > 0) {
-                            const auto read_bytes =
-                                v4l2_read(_file_descriptor, _encoded_bytes.data(), _encoded_bytes.size());
-                            jpeg_mem_src(&decompress_information, _encoded_bytes.data(), read_bytes);
-                            jpeg_read_header(&decompress_information, 1);
-                            jpeg_start_decompress(&decompress_information);
-                            auto output = _bytes.data();
-                            while (decompress_information.output_scanline < decompress_information.image_height) {
-                                const auto lines_read = jpeg_read_scanlines(
-                                    &decompress_information, reinterpret_cast<JSAMPARRAY>(&output), 1);
-                                output += lines_read * decompress_information.image_width
-                                          * decompress_information.num_components;
+                    } catch (...) {
+                        _handle_exception(std::current_exception());
+                    }
+                });
+            }
+            if (_event_loop) {
+                _event_loop->add(_file_descriptor, [this]() {
+                    try {
+                        capture_frame();
+                    } catch (...) {
+                        _event_loop->remove(_file_descriptor);
+                        _handle_exception(std::current_exception());
+                    }
+                });
+            } else {
+                _loop = std::thread([this]() {
+                    try {
+                        pollfd poll_file_descriptor;
+                        poll_file_descriptor.fd = _file_descriptor;
+                        poll_file_descriptor.events = POLLIN;
+                        while (_running.load(std::memory_order_acquire)) {
+                            const auto poll_result = poll(&poll_file_descriptor, 1, 25);
+                            if (poll_result < 0) {
+                                throw std::runtime_error("poll LiveTrack failed");
+                            }
+                            if (poll_result > 0) {
+                                capture_frame();
                             }
-                            jpeg_finish_decompress(&decompress_information);
-                            _handle_frame(_bytes);
                         }
+                    } catch (...) {
+                        _handle_exception(std::current_exception());
                     }
-                } catch (...) {
-                    _handle_exception(std::current_exception());
-                }
-                jpeg_destroy_decompress(&decompress_information);
-            });
+                });
+            }
         }
         livetrack_video_observable(const livetrack_video_observable&) = delete;
         livetrack_video_observable(livetrack_video_observable&&) = default;
@@ -103,18 +229,327 @@ namespace hibiscus {
         livetrack_video_observable& operator=(livetrack_video_observable&&) = default;
         virtual ~livetrack_video_observable() {
             _running.store(false, std::memory_order_release);
-            _loop.join();
+            if (_event_loop) {
+                _event_loop->remove(_file_descriptor);
+            } else {
+                _loop.join();
+            }
+            if (_decoder.joinable()) {
+                _condition_variable.notify_one();
+                _decoder.join();
+            }
+            jpeg_destroy_decompress(&_decompress_information);
+            stop_streaming();
             v4l2_close(_file_descriptor);
         }
 
+        /// streaming returns true if frames are copied from kernel buffers, and false if they are copied with read.
+        bool streaming() const {
+            return !_mapped_buffers.empty();
+        }
+
+        /// width returns the number of pixels per row in decoded frames.
+        std::size_t width() const {
+            return _width;
+        }
+
+        /// height returns the number of rows in decoded frames.
+        std::size_t height() const {
+            return _height;
+        }
+
+        /// components returns the number of bytes per pixel in decoded frames (1 for grayscale, 3 for RGB).
+        std::size_t components() const {
+            return _grayscale ? 1 : 3;
+        }
+
+        /// regions returns the decoded regions, if any.
+        const std::vector<livetrack_video_region>& regions() const {
+            return _regions;
+        }
+
+        /// region_offset returns the position of the given region's first pixel in decoded frames.
+        /// Each region is stored row by row, with regions()[index].width pixels per row.
+        std::size_t region_offset(std::size_t index) const {
+            return _region_offsets[index];
+        }
+
+        /// decode_histogram returns the distribution of the time spent decoding each frame.
+        const latency_histogram& decode_histogram() const {
+            return _decode_histogram;
+        }
+
+        /// captured returns the number of frames retrieved from the driver.
+        uint64_t captured() const {
+            return _captured.load(std::memory_order_relaxed);
+        }
+
+        /// decoded returns the number of frames decoded and dispatched.
+        uint64_t decoded() const {
+            return _decoded.load(std::memory_order_relaxed);
+        }
+
+        /// dropped returns the number of frames replaced by a newer frame before the decoder retrieved them.
+        uint64_t dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+
         protected:
+        /// mapped_buffer represents a kernel buffer mapped in the process memory.
+        struct mapped_buffer {
+            uint8_t* data;
+            std::size_t size;
+        };
+
+        /// encoded_frame holds a frame handed over from the capture thread to the decoding thread.
+        struct encoded_frame {
+            std::vector<uint8_t> bytes;
+            std::size_t size;
+            std::chrono::steady_clock::time_point t;
+        };
+
+        /// start_streaming requests and maps kernel buffers, queues them and starts the capture.
+        /// The observable falls back to read if the driver does not support streaming.
+        void start_streaming(std::size_t buffers) {
+            v4l2_capability capability{};
+            if (v4l2_ioctl(_file_descriptor, VIDIOC_QUERYCAP, &capability) < 0
+                || (capability.capabilities & V4L2_CAP_STREAMING) == 0) {
+                return;
+            }
+            v4l2_requestbuffers request{};
+            request.count = static_cast<uint32_t>(buffers);
+            request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            request.memory = V4L2_MEMORY_MMAP;
+            if (v4l2_ioctl(_file_descriptor, VIDIOC_REQBUFS, &request) < 0) {
+                return;
+            }
+            _requested_buffers = true;
+            if (request.count < 2) {
+                throw std::runtime_error("the LiveTrack driver allocated less than two buffers");
+            }
+            for (uint32_t index = 0; index < request.count; ++index) {
+                v4l2_buffer buffer{};
+                buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                buffer.memory = V4L2_MEMORY_MMAP;
+                buffer.index = index;
+                if (v4l2_ioctl(_file_descriptor, VIDIOC_QUERYBUF, &buffer) < 0) {
+                    throw std::runtime_error("querying a LiveTrack buffer failed");
+                }
+                const auto data = v4l2_mmap(
+                    nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, _file_descriptor, buffer.m.offset);
+                if (data == MAP_FAILED) {
+                    throw std::runtime_error("mapping a LiveTrack buffer failed");
+                }
+                _mapped_buffers.push_back({reinterpret_cast<uint8_t*>(data), buffer.length});
+                if (v4l2_ioctl(_file_descriptor, VIDIOC_QBUF, &buffer) < 0) {
+                    throw std::runtime_error("queuing a LiveTrack buffer failed");
+                }
+            }
+            auto type = static_cast<int>(V4L2_BUF_TYPE_VIDEO_CAPTURE);
+            if (v4l2_ioctl(_file_descriptor, VIDIOC_STREAMON, &type) < 0) {
+                throw std::runtime_error("starting the LiveTrack stream failed");
+            }
+        }
+
+        /// stop_streaming stops the capture and releases the kernel buffers, if any.
+        void stop_streaming() {
+            if (!_mapped_buffers.empty()) {
+                auto type = static_cast<int>(V4L2_BUF_TYPE_VIDEO_CAPTURE);
+                v4l2_ioctl(_file_descriptor, VIDIOC_STREAMOFF, &type);
+                for (const auto& buffer : _mapped_buffers) {
+                    v4l2_munmap(buffer.data, buffer.size);
+                }
+                _mapped_buffers.clear();
+            }
+            if (_requested_buffers) {
+                v4l2_requestbuffers request{};
+                request.count = 0;
+                request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                request.memory = V4L2_MEMORY_MMAP;
+                v4l2_ioctl(_file_descriptor, VIDIOC_REQBUFS, &request);
+                _requested_buffers = false;
+            }
+        }
+
+        /// capture_frame copies an encoded frame to the triple buffer and hands it over to the decoding thread,
+        /// after appending it to the logger if any.
+        virtual void capture_frame() {
+            auto& frame = _frames.back();
+            if (_mapped_buffers.empty()) {
+                frame.bytes.resize(_raw_frame_size);
+                const auto read_bytes = v4l2_read(_file_descriptor, frame.bytes.data(), frame.bytes.size());
+                if (read_bytes < 0) {
+                    if (errno == EAGAIN || errno == EINTR) {
+                        return;
+                    }
+                    throw std::runtime_error("reading from the LiveTrack failed");
+                }
+                frame.size = static_cast<std::size_t>(read_bytes);
+                frame.t = std::chrono::steady_clock::now();
+                if (_logger) {
+                    _logger->append(frame.bytes.data(), frame.size, frame.t);
+                }
+            } else {
+                v4l2_buffer buffer{};
+                buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                buffer.memory = V4L2_MEMORY_MMAP;
+                if (v4l2_ioctl(_file_descriptor, VIDIOC_DQBUF, &buffer) < 0) {
+                    if (errno == EAGAIN || errno == EINTR) {
+                        return;
+                    }
+                    throw std::runtime_error("dequeuing a LiveTrack buffer failed");
+                }
+                // the monotonic driver clock is the steady clock's source on Linux
+                frame.t = std::chrono::steady_clock::now();
+                if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+                    const auto capture_t = std::chrono::seconds(buffer.timestamp.tv_sec)
+                                           + std::chrono::microseconds(buffer.timestamp.tv_usec);
+                    frame.t = std::chrono::steady_clock::time_point(
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(capture_t));
+                }
+                // the copy (a few tens of kilobytes) gives the buffer back to the driver before decoding
+                frame.size = buffer.bytesused;
+                if (_decode) {
+                    if (frame.bytes.size() < frame.size) {
+                        frame.bytes.resize(frame.size);
+                    }
+                    std::copy_n(_mapped_buffers[buffer.index].data, frame.size, frame.bytes.begin());
+                }
+                if (_logger) {
+                    try {
+                        _logger->append(_mapped_buffers[buffer.index].data, frame.size, frame.t);
+                    } catch (const std::runtime_error&) {
+                        v4l2_ioctl(_file_descriptor, VIDIOC_QBUF, &buffer);
+                        throw;
+                    }
+                }
+                if (v4l2_ioctl(_file_descriptor, VIDIOC_QBUF, &buffer) < 0) {
+                    throw std::runtime_error("queuing a LiveTrack buffer failed");
+                }
+            }
+            _captured.fetch_add(1, std::memory_order_relaxed);
+            if (!_decode) {
+                return;
+            }
+            if (!_frames.publish()) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            {
+                // locking the mutex ensures that the decoder is either waiting or about to check for a new frame
+                std::lock_guard<std::mutex> lock(_mutex);
+            }
+            _condition_variable.notify_one();
+        }
+
+        /// decode_frame decodes a frame handed over by the capture thread and dispatches it.
+        virtual void decode_frame(const encoded_frame& frame) {
+            const auto decode_begin = std::chrono::steady_clock::now();
+            decode(frame.bytes.data(), frame.size);
+            _decode_histogram.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - decode_begin));
+            _decoded.fetch_add(1, std::memory_order_relaxed);
+            _handle_frame(_bytes, frame.t);
+        }
+
+        /// decode converts an MJPEG frame to scaled RGB or grayscale bytes, or to regions.
+        /// The decoder outputs as many rows per call as it produces at once (several with vertical upsampling).
+        virtual void decode(const uint8_t* encoded_bytes, std::size_t size) {
+            jpeg_mem_src(&_decompress_information, const_cast<uint8_t*>(encoded_bytes), size);
+            // jpeg_read_header resets the decompression parameters
+            jpeg_read_header(&_decompress_information, 1);
+            _decompress_information.scale_num = 1;
+            _decompress_information.scale_denom = _scale_denominator;
+            _decompress_information.out_color_space = _grayscale ? JCS_GRAYSCALE : JCS_RGB;
+            _decompress_information.do_fancy_upsampling = false;
+            jpeg_start_decompress(&_decompress_information);
+            if (_decompress_information.output_width != _width || _decompress_information.output_height != _height) {
+                jpeg_abort_decompress(&_decompress_information);
+                throw std::runtime_error("unexpected LiveTrack frame dimensions");
+            }
+            if (!_regions.empty()) {
+                decode_regions();
+                return;
+            }
+            while (_decompress_information.output_scanline < _decompress_information.output_height) {
+                jpeg_read_scanlines(
+                    &_decompress_information,
+                    _rows.data() + _decompress_information.output_scanline,
+                    _decompress_information.output_height - _decompress_information.output_scanline);
+            }
+            jpeg_finish_decompress(&_decompress_information);
+        }
+
+        /// decode_regions reads the rows spanned by the regions of a started decompression,
+        /// and copies each region to the frame bytes.
+        void decode_regions() {
+            JDIMENSION x_offset = 0;
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+            // jpeg_crop_scanline moves the offset left and widens the crop to align them with the blocks
+            x_offset = static_cast<JDIMENSION>(_regions_x_begin);
+            auto crop_width = static_cast<JDIMENSION>(_regions_x_end - _regions_x_begin);
+            jpeg_crop_scanline(&_decompress_information, &x_offset, &crop_width);
+            if (_regions_y_begin > 0) {
+                jpeg_skip_scanlines(&_decompress_information, static_cast<JDIMENSION>(_regions_y_begin));
+            }
+#else
+            while (_decompress_information.output_scanline < _regions_y_begin) {
+                jpeg_read_scanlines(&_decompress_information, _rows.data(), 1);
+            }
+#endif
+            while (_decompress_information.output_scanline < _regions_y_end) {
+                jpeg_read_scanlines(
+                    &_decompress_information,
+                    _rows.data() + (_decompress_information.output_scanline - _regions_y_begin),
+                    static_cast<JDIMENSION>(_regions_y_end - _decompress_information.output_scanline));
+            }
+            // the rows below the regions are not needed, and jpeg_finish_decompress would require them
+            jpeg_abort_decompress(&_decompress_information);
+            for (std::size_t index = 0; index < _regions.size(); ++index) {
+                const auto& region = _regions[index];
+                const auto row_size = region.width * components();
+                for (std::size_t y = 0; y < region.height; ++y) {
+                    std::memcpy(
+                        _bytes.data() + _region_offsets[index] + y * row_size,
+                        _rows[region.y + y - _regions_y_begin] + (region.x - x_offset) * components(),
+                        row_size);
+                }
+            }
+        }
+
         HandleFrame _handle_frame;
         HandleException _handle_exception;
+        reactor* _event_loop;
         std::atomic_bool _running;
+        const bool _decode;
+        livetrack_video_logger* _logger;
         std::thread _loop;
         int32_t _file_descriptor;
+        jpeg_decompress_struct _decompress_information;
+        jpeg_error_mgr _error_message;
+        uint32_t _scale_denominator;
+        std::size_t _width;
+        std::size_t _height;
+        bool _grayscale;
+        std::vector<livetrack_video_region> _regions;
+        std::vector<std::size_t> _region_offsets;
+        std::size_t _regions_x_begin;
+        std::size_t _regions_x_end;
+        std::size_t _regions_y_begin;
+        std::size_t _regions_y_end;
+        std::size_t _raw_frame_size;
         std::vector<uint8_t> _bytes;
-        std::vector<uint8_t> _encoded_bytes;
+        std::vector<uint8_t> _strip;
+        std::vector<JSAMPROW> _rows;
+        std::vector<mapped_buffer> _mapped_buffers;
+        bool _requested_buffers;
+        triple_buffer<encoded_frame> _frames;
+        std::thread _decoder;
+        std::mutex _mutex;
+        std::condition_variable _condition_variable;
+        latency_histogram _decode_histogram;
+        std::atomic<uint64_t> _captured;
+        std::atomic<uint64_t> _decoded;
+        std::atomic<uint64_t> _dropped;
     };
 
     /// make_livetrack_video_observable creates a livetrack_video_observable from
@@ -123,9 +558,19 @@ namespace hibiscus {
     std::unique_ptr<livetrack_video_observable<HandleFrame, HandleException>> make_livetrack_video_observable(
         const std::string& source,
         HandleFrame handle_frame,
-        HandleException handle_exception) {
+        HandleException handle_exception,
+        reactor* event_loop = nullptr,
+        std::size_t buffers = 4,
+        livetrack_video_output output = {},
+        livetrack_video_logger* logger = nullptr) {
         return std::unique_ptr<livetrack_video_observable<HandleFrame, HandleException>>(
             new livetrack_video_observable<HandleFrame, HandleException>(
-                source, std::forward<HandleFrame>(handle_frame), std::forward<HandleException>(handle_exception)));
+                source,
+                std::forward<HandleFrame>(handle_frame),
+                std::forward<HandleException>(handle_exception),
+                event_loop,
+                buffers,
+                output,
+                logger));
     }
 }
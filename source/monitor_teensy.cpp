@@ -4,6 +4,10 @@
 
 int main(int argc, char* argv[]) {
     try {
+        if (argc > 2) {
+            throw std::runtime_error("Syntax: ./monitor_teensy [/path/to/teensy]");
+        }
+        const std::string filename = argc == 2 ? argv[1] : hibiscus::default_teensy_filename;
         std::exception_ptr pipeline_exception;
         std::atomic_bool running(true);
         auto terminal = hibiscus::make_terminal(
@@ -43,7 +47,8 @@ int main(int argc, char* argv[]) {
             [&](std::exception_ptr exception) {
                 pipeline_exception = exception;
                 running.store(false, std::memory_order_release);
-            });
+            },
+            filename);
         while (running.load(std::memory_order_acquire)) {
             std::this_thread::sleep_for(std::chrono::milliseconds(20));
         }
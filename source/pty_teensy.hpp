@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// pty_teensy emulates the record firmware on the master side of a pseudo-terminal.
+    /// The host opens the slave side (filename) as it would open a Teensy.
+    class pty_teensy {
+        public:
+        pty_teensy() :
+            _master(posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK)),
+            _dropped_bytes(0),
+            _written_messages(0),
+            _written_bytes(0),
+            _extended_timestamps(false),
+            _reading(false),
+            _escaped(false) {
+            if (_master < 0 || grantpt(_master) < 0 || unlockpt(_master) < 0) {
+                throw std::runtime_error("creating the pseudo-terminal failed");
+            }
+            _filename = ptsname(_master);
+            // an open slave keeps the master readable when the host disconnects
+            _slave = open(_filename.c_str(), O_RDWR | O_NOCTTY);
+            if (_slave < 0) {
+                throw std::runtime_error(std::string("opening '") + _filename + "' failed");
+            }
+            termios options;
+            if (tcgetattr(_slave, &options) < 0) {
+                throw std::logic_error("getting the terminal options failed");
+            }
+            cfmakeraw(&options);
+            if (tcsetattr(_slave, TCSANOW, &options) < 0) {
+                throw std::logic_error("setting the terminal options failed");
+            }
+        }
+        pty_teensy(const pty_teensy&) = delete;
+        pty_teensy(pty_teensy&&) = default;
+        pty_teensy& operator=(const pty_teensy&) = delete;
+        pty_teensy& operator=(pty_teensy&&) = default;
+        virtual ~pty_teensy() {
+            close(_slave);
+            close(_master);
+        }
+
+        /// filename returns the slave device path, to be opened by the host.
+        const std::string& filename() const {
+            return _filename;
+        }
+
+        /// dropped_bytes returns the number of bytes that did not fit in the pseudo-terminal buffer.
+        std::size_t dropped_bytes() const {
+            return _dropped_bytes;
+        }
+
+        /// written_messages returns the number of messages generated so far.
+        std::size_t written_messages() const {
+            return _written_messages;
+        }
+
+        /// written_bytes returns the number of bytes consumed by the host so far.
+        std::size_t written_bytes() const {
+            return _written_bytes;
+        }
+
+        /// open_log starts copying the bytes consumed by the host to the given file.
+        /// The file can be played back with replay.
+        void open_log(const std::string& filename) {
+            _log.open(filename, std::ofstream::binary | std::ofstream::trunc);
+            if (!_log.good()) {
+                throw std::runtime_error(std::string("'") + filename + "' could not be open for writing");
+            }
+        }
+
+        /// set_extended_timestamps selects 64-bit (true) or 32-bit (false) timestamps.
+        void set_extended_timestamps(bool extended_timestamps) {
+            _extended_timestamps = extended_timestamps;
+        }
+
+        /// append_t encodes a timestamp like the firmware's write_t.
+        /// t is truncated to 32 bits unless extended timestamps are enabled.
+        void append_t(std::vector<uint8_t>& message, uint64_t t) const {
+            for (uint8_t index = 0; index < (_extended_timestamps ? 8 : 4); ++index) {
+                message.push_back(static_cast<uint8_t>((t >> (8 * index)) & 0xff));
+            }
+        }
+
+        /// send generates and writes a timestamped message, like the firmware's send.
+        void send(uint8_t type, uint64_t t) {
+            std::vector<uint8_t> message{type};
+            append_t(message, t);
+            write(message);
+        }
+
+        /// send_value generates and writes a message with a 32-bit payload, like the firmware's send_value.
+        void send_value(uint8_t type, uint32_t value) {
+            write({{
+                type,
+                static_cast<uint8_t>(value & 0xff),
+                static_cast<uint8_t>((value >> 8) & 0xff),
+                static_cast<uint8_t>((value >> 16) & 0xff),
+                static_cast<uint8_t>((value >> 24) & 0xff),
+            }});
+        }
+
+        /// write escapes a message and appends it to the output buffer.
+        void write(const std::vector<uint8_t>& message) {
+            ++_written_messages;
+            _output.push_back(0x00);
+            for (auto byte : message) {
+                switch (byte) {
+                    case 0x00:
+                        _output.push_back(0xaa);
+                        _output.push_back(0xab);
+                        break;
+                    case 0xaa:
+                        _output.push_back(0xaa);
+                        _output.push_back(0xac);
+                        break;
+                    case 0xff:
+                        _output.push_back(0xaa);
+                        _output.push_back(0xad);
+                        break;
+                    default:
+                        _output.push_back(byte);
+                }
+            }
+            _output.push_back(0xff);
+        }
+
+        /// flush sends the output buffer to the host.
+        /// Bytes are dropped if the host does not consume them, like the firmware's USB serial does.
+        void flush() {
+            if (!_output.empty()) {
+                const auto bytes_written = ::write(_master, _output.data(), _output.size());
+                if (bytes_written > 0) {
+                    _written_bytes += bytes_written;
+                    if (_log.is_open()) {
+                        _log.write(reinterpret_cast<const char*>(_output.data()), bytes_written);
+                    }
+                }
+                if (bytes_written < static_cast<ssize_t>(_output.size())) {
+                    _dropped_bytes += _output.size() - (bytes_written < 0 ? 0 : bytes_written);
+                }
+                _output.clear();
+            }
+        }
+
+        /// read waits at most timeout for host messages, and calls handle_message for each one.
+        template <typename HandleMessage>
+        void read(std::chrono::microseconds timeout, HandleMessage handle_message) {
+            pollfd poll_file_descriptor;
+            poll_file_descriptor.fd = _master;
+            poll_file_descriptor.events = POLLIN;
+            timespec timeout_as_timespec;
+            timeout_as_timespec.tv_sec = timeout.count() / 1000000;
+            timeout_as_timespec.tv_nsec = (timeout.count() % 1000000) * 1000;
+            if (ppoll(&poll_file_descriptor, 1, &timeout_as_timespec, nullptr) <= 0
+                || (poll_file_descriptor.revents & POLLIN) == 0) {
+                return;
+            }
+            const auto bytes_read = ::read(_master, _input.data(), _input.size());
+            for (ssize_t index = 0; index < bytes_read; ++index) {
+                const auto byte = _input[index];
+                if (_reading) {
+                    if (_escaped) {
+                        _escaped = false;
+                        switch (byte) {
+                            case 0xab:
+                                _message.push_back(0x00);
+                                break;
+                            case 0xac:
+                                _message.push_back(0xaa);
+                                break;
+                            case 0xad:
+                                _message.push_back(0xff);
+                                break;
+                            default:
+                                _reading = false;
+                        }
+                    } else {
+                        switch (byte) {
+                            case 0x00:
+                                _message.clear();
+                                break;
+                            case 0xaa:
+                                _escaped = true;
+                                break;
+                            case 0xff:
+                                _reading = false;
+                                handle_message(_message);
+                                break;
+                            default:
+                                _message.push_back(byte);
+                        }
+                    }
+                } else if (byte == 0x00) {
+                    _reading = true;
+                    _escaped = false;
+                    _message.clear();
+                }
+            }
+        }
+
+        /// replay plays back bytes recorded with open_log, and returns once the host has read all of them.
+        /// The bytes preceding the reset reply are skipped, and the replay waits for the host's handshake
+        /// like the firmware: the reset reply is written when the host sends 'r', and the remaining bytes
+        /// once it sends 'x'. Logs recorded without extended timestamps have no 'x' reply, hence the remaining bytes
+        /// are held until the host has given up waiting for it. They are written as fast as the host reads them.
+        /// false is returned if running was cleared before the end of the log.
+        bool replay(const std::vector<uint8_t>& log, const std::atomic_bool& running) {
+            // messages only contain 0x00 and 0xff as delimiters, hence replies can be found without decoding
+            const auto find_reply = [&](std::size_t begin, uint8_t type) {
+                for (auto index = begin; index + 2 < log.size(); ++index) {
+                    if (log[index] == 0x00 && log[index + 1] == type && log[index + 2] == 0xff) {
+                        return index;
+                    }
+                }
+                return log.size();
+            };
+            const auto reset_begin = find_reply(0, 'r');
+            if (reset_begin == log.size()) {
+                throw std::runtime_error("the log does not contain a reset reply");
+            }
+            const auto has_extended_reply = find_reply(reset_begin + 3, 'x') < log.size();
+            std::size_t released = reset_begin;
+            std::size_t written = reset_begin;
+            auto extended_requested = false;
+            std::chrono::steady_clock::time_point extended_t;
+            const auto handle_message = [&](const std::vector<uint8_t>& message) {
+                if (message.size() == 1) {
+                    if (message[0] == 'r') {
+                        released = std::max(released, reset_begin + 3);
+                    } else if (message[0] == 'x' && released > reset_begin) {
+                        extended_requested = true;
+                        extended_t = std::chrono::steady_clock::now();
+                        if (has_extended_reply) {
+                            released = log.size();
+                        }
+                    }
+                }
+            };
+            while (written < log.size() || pending_bytes() > 0) {
+                if (!running.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                // the host waits 500 ms for the extended timestamps reply
+                if (extended_requested
+                    && std::chrono::steady_clock::now() - extended_t > std::chrono::milliseconds(600)) {
+                    released = log.size();
+                }
+                if (written < released) {
+                    read(std::chrono::microseconds(0), handle_message);
+                    pollfd poll_file_descriptor;
+                    poll_file_descriptor.fd = _master;
+                    poll_file_descriptor.events = POLLOUT;
+                    if (poll(&poll_file_descriptor, 1, 10) > 0 && (poll_file_descriptor.revents & POLLOUT)) {
+                        const auto bytes_written = ::write(_master, log.data() + written, released - written);
+                        if (bytes_written > 0) {
+                            written += bytes_written;
+                            _written_bytes += bytes_written;
+                        }
+                    }
+                } else {
+                    read(std::chrono::milliseconds(10), handle_message);
+                }
+            }
+            return true;
+        }
+
+        protected:
+        /// pending_bytes returns the number of bytes waiting to be read by the host.
+        std::size_t pending_bytes() const {
+            int bytes = 0;
+            if (ioctl(_slave, FIONREAD, &bytes) < 0) {
+                return 0;
+            }
+            return static_cast<std::size_t>(bytes);
+        }
+
+        int32_t _master;
+        int32_t _slave;
+        std::string _filename;
+        std::size_t _dropped_bytes;
+        std::size_t _written_messages;
+        std::size_t _written_bytes;
+        bool _extended_timestamps;
+        std::ofstream _log;
+        std::vector<uint8_t> _output;
+        std::array<uint8_t, 1 << 12> _input;
+        std::vector<uint8_t> _message;
+        bool _reading;
+        bool _escaped;
+    };
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// reactor waits for several file descriptors and timers on a single thread.
+    /// Handlers are called from the reactor thread whenever their file descriptor is readable.
+    class reactor {
+        public:
+        reactor() {
+            _epoll_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+            if (_epoll_file_descriptor < 0) {
+                throw std::runtime_error("creating the epoll instance failed");
+            }
+            _wake_file_descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (_wake_file_descriptor < 0) {
+                close(_epoll_file_descriptor);
+                throw std::runtime_error("creating the wake event failed");
+            }
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = _wake_file_descriptor;
+            if (epoll_ctl(_epoll_file_descriptor, EPOLL_CTL_ADD, _wake_file_descriptor, &event) < 0) {
+                close(_wake_file_descriptor);
+                close(_epoll_file_descriptor);
+                throw std::runtime_error("registering the wake event failed");
+            }
+        }
+        reactor(const reactor&) = delete;
+        reactor(reactor&&) = default;
+        reactor& operator=(const reactor&) = delete;
+        reactor& operator=(reactor&&) = default;
+        virtual ~reactor() {
+            close(_wake_file_descriptor);
+            close(_epoll_file_descriptor);
+        }
+
+        /// add registers a file descriptor.
+        /// handle_ready is called from the reactor thread as long as the file descriptor is readable,
+        /// hence it must consume the available data.
+        virtual void add(int32_t file_descriptor, std::function<void()> handle_ready) {
+            std::lock_guard<std::recursive_mutex> lock(_dispatching);
+            _handlers[file_descriptor] = std::make_shared<std::function<void()>>(std::move(handle_ready));
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = file_descriptor;
+            if (epoll_ctl(_epoll_file_descriptor, EPOLL_CTL_ADD, file_descriptor, &event) < 0) {
+                _handlers.erase(file_descriptor);
+                throw std::runtime_error("registering a file descriptor with the reactor failed");
+            }
+        }
+
+        /// remove unregisters a file descriptor.
+        /// When called from another thread, remove waits for the running handlers to return,
+        /// hence the file descriptor's handler is never called after remove returns.
+        /// Unknown file descriptors are ignored.
+        virtual void remove(int32_t file_descriptor) {
+            std::lock_guard<std::recursive_mutex> lock(_dispatching);
+            if (_handlers.erase(file_descriptor) > 0) {
+                epoll_ctl(_epoll_file_descriptor, EPOLL_CTL_DEL, file_descriptor, nullptr);
+            }
+        }
+
+        /// add_timer calls handle_timer periodically from the reactor thread.
+        /// The returned identifier must be passed to remove_timer.
+        virtual int32_t add_timer(std::chrono::microseconds period, std::function<void()> handle_timer) {
+            const auto timer_file_descriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (timer_file_descriptor < 0) {
+                throw std::runtime_error("creating a timer failed");
+            }
+            itimerspec specification;
+            specification.it_interval.tv_sec = static_cast<time_t>(period.count() / 1000000);
+            specification.it_interval.tv_nsec = static_cast<long>((period.count() % 1000000) * 1000);
+            specification.it_value = specification.it_interval;
+            if (timerfd_settime(timer_file_descriptor, 0, &specification, nullptr) < 0) {
+                close(timer_file_descriptor);
+                throw std::runtime_error("arming a timer failed");
+            }
+            try {
+                add(timer_file_descriptor, [timer_file_descriptor, handle_timer]() {
+                    uint64_t expirations;
+                    if (::read(timer_file_descriptor, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                        handle_timer();
+                    }
+                });
+            } catch (const std::runtime_error&) {
+                close(timer_file_descriptor);
+                throw;
+            }
+            return timer_file_descriptor;
+        }
+
+        /// remove_timer stops and destroys a timer.
+        virtual void remove_timer(int32_t timer) {
+            remove(timer);
+            close(timer);
+        }
+
+        protected:
+        /// dispatch waits for at least one file descriptor to become readable, and calls the matching handlers.
+        /// It returns early if wake is called from another thread.
+        void dispatch() {
+            const auto events_count = epoll_wait(_epoll_file_descriptor, _events.data(), _events.size(), -1);
+            if (events_count < 0) {
+                if (errno == EINTR) {
+                    return;
+                }
+                throw std::runtime_error("waiting for the reactor events failed");
+            }
+            std::lock_guard<std::recursive_mutex> lock(_dispatching);
+            for (int32_t index = 0; index < events_count; ++index) {
+                const auto file_descriptor = _events[index].data.fd;
+                if (file_descriptor == _wake_file_descriptor) {
+                    uint64_t count;
+                    while (::read(_wake_file_descriptor, &count, sizeof(count)) == sizeof(count)) {
+                    }
+                    continue;
+                }
+                const auto handler = _handlers.find(file_descriptor);
+                if (handler != _handlers.end()) {
+                    // the handler may remove itself, hence a copy of the shared pointer is kept alive
+                    const auto handle_ready = handler->second;
+                    (*handle_ready)();
+                }
+            }
+        }
+
+        /// wake interrupts a pending dispatch.
+        void wake() {
+            const uint64_t count = 1;
+            if (::write(_wake_file_descriptor, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                throw std::runtime_error("waking the reactor failed");
+            }
+        }
+
+        int32_t _epoll_file_descriptor;
+        int32_t _wake_file_descriptor;
+        std::array<epoll_event, 16> _events;
+        std::recursive_mutex _dispatching;
+        std::unordered_map<int32_t, std::shared_ptr<std::function<void()>>> _handlers;
+    };
+
+    /// specialized_reactor runs a reactor on a dedicated thread.
+    template <typename HandleException>
+    class specialized_reactor : public reactor {
+        public:
+        specialized_reactor(HandleException handle_exception) :
+            reactor(),
+            _handle_exception(std::forward<HandleException>(handle_exception)),
+            _running(true) {
+            _loop = std::thread([this]() {
+                try {
+                    while (_running.load(std::memory_order_acquire)) {
+                        dispatch();
+                    }
+                } catch (...) {
+                    _handle_exception(std::current_exception());
+                }
+            });
+        }
+        specialized_reactor(const specialized_reactor&) = delete;
+        specialized_reactor(specialized_reactor&&) = default;
+        specialized_reactor& operator=(const specialized_reactor&) = delete;
+        specialized_reactor& operator=(specialized_reactor&&) = default;
+        virtual ~specialized_reactor() {
+            _running.store(false, std::memory_order_release);
+            wake();
+            _loop.join();
+        }
+
+        protected:
+        HandleException _handle_exception;
+        std::atomic_bool _running;
+        std::thread _loop;
+    };
+
+    /// make_reactor creates a reactor running on its own thread.
+    template <typename HandleException>
+    std::unique_ptr<specialized_reactor<HandleException>> make_reactor(HandleException handle_exception) {
+        return std::unique_ptr<specialized_reactor<HandleException>>(
+            new specialized_reactor<HandleException>(std::forward<HandleException>(handle_exception)));
+    }
+}
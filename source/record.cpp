@@ -6,8 +6,14 @@
 #include "../third_party/sepia/source/sepia.hpp"
 #include "../third_party/tarsier/source/merge.hpp"
 #include "calibration.hpp"
-#include "livetrack_data_observable.hpp"
+#include "gaze_classifier.hpp"
+#include "livetrack_clock.hpp"
+#include "livetrack_replay_observable.hpp"
+#include "livetrack_video_observable.hpp"
+#include "ring_buffer.hpp"
+#include "reactor.hpp"
 #include "teensy.hpp"
+#include <sstream>
 
 /// dmd_state determines which action to take on DMD events.
 enum class dmd_state {
@@ -16,6 +22,15 @@ enum class dmd_state {
     write,
 };
 
+/// livetrack_edge represents an io bit 22 transition waiting for the matching Teensy sync message.
+/// t is the LiveTrack estimate of the edge, and after_t the timestamp of the first sample at the new level.
+struct livetrack_edge {
+    double t;
+    uint64_t after_t;
+    bool is_high;
+    std::chrono::steady_clock::time_point host_t;
+};
+
 int main(int argc, char* argv[]) {
     return pontella::main(
         {
@@ -42,14 +57,66 @@ int main(int argc, char* argv[]) {
             "    -i [ip], --ip [ip]                sets the LightCrafter IP "
             "address",
             "                                          defaults to 10.10.10.100",
+            "    -t [paths], --teensy [paths]      sets the Teensy device paths or USB serial numbers,",
+            "                                          separated by commas",
+            "                                          defaults to /dev/ttyACM0",
+            "                                          the first Teensy is wired to the display and the LiveTrack,",
+            "                                          the others only report button pushes",
+            "    -l [path], --livetrack-replay [path]",
+            "                                      reads the LiveTrack samples from raw reports or a log file",
+            "                                          instead of the eye tracker",
+            "    -s [speed], --replay-speed [speed]",
+            "                                      sets the replay speed, 0 replays as fast as possible",
+            "                                          defaults to 1",
+            "    -w [path], --livetrack-log [path] writes the raw LiveTrack reports to the given file",
+            "    -v [path], --livetrack-video [path]",
+            "                                      writes the LiveTrack MJPEG frames to the given file",
+            "                                          and their capture times to path.index",
+            "    -k [samples], --livetrack-buffer [samples]",
+            "                                      sets the number of LiveTrack samples waiting for a sync edge",
+            "                                          defaults to 65536",
+            "    -o [policy], --livetrack-overflow [policy]",
+            "                                      sets the behaviour when the LiveTrack buffer is full, one of:",
+            "                                          drop (the oldest samples are dropped)",
+            "                                          extrapolate (the oldest samples are written with the current",
+            "                                              clock fit)",
+            "                                          defaults to drop",
+            "    -x [timing], --livetrack-timing [timing]",
+            "                                      sets when the LiveTrack samples are written, one of:",
+            "                                          interpolate (after the next sync edge)",
+            "                                          extrapolate (immediately, with the current clock fit)",
+            "                                          defaults to interpolate",
+            "    -y [us], --sync-period [us]       makes the Teensy toggle the sync output periodically,",
+            "                                          with the given interval in microseconds between edges",
+            "                                          the interval must be longer than two LiveTrack samples",
+            "                                          defaults to 0 (each edge is sent once the previous one",
+            "                                          is received by the LiveTrack and echoed by the Teensy)",
             "    -e, --fake-events                 send fake button pushes periodically",
+            "    -r, --reactor                     reads the Teensy and the LiveTrack from a single epoll thread",
+            "    -m [mode], --dmd-mode [mode]      sets the DMD protocol, one of:",
+            "                                          subframes (one Teensy message per subframe)",
+            "                                          expanded (one Teensy message per frame, one event per subframe)",
+            "                                          compact (one Teensy message and one event per frame)",
+            "                                          defaults to subframes",
             "    -h, --help                            shows this help message",
         },
         argc,
         argv,
         -1,
-        {{"duration", {"d"}}, {"buffer", {"b"}}, {"ip", {"i"}}},
-        {{"force", {"f"}}, {"fake-events", {"e"}}},
+        {{"duration", {"d"}},
+         {"buffer", {"b"}},
+         {"ip", {"i"}},
+         {"teensy", {"t"}},
+         {"dmd-mode", {"m"}},
+         {"livetrack-replay", {"l"}},
+         {"replay-speed", {"s"}},
+         {"livetrack-log", {"w"}},
+         {"livetrack-video", {"v"}},
+         {"livetrack-buffer", {"k"}},
+         {"livetrack-overflow", {"o"}},
+         {"livetrack-timing", {"x"}},
+         {"sync-period", {"y"}}},
+        {{"force", {"f"}}, {"fake-events", {"e"}}, {"reactor", {"r"}}},
         [](pontella::command command) {
             if (command.arguments.size() < 3) {
                 throw std::runtime_error("at least three arguments are required (a calibration file input, a clip "
@@ -100,7 +167,127 @@ int main(int argc, char* argv[]) {
                     fifo_size = std::stoull(name_and_value->second);
                 }
             }
+            std::string livetrack_replay_filename;
+            {
+                const auto name_and_value = command.options.find("livetrack-replay");
+                if (name_and_value != command.options.end()) {
+                    livetrack_replay_filename = name_and_value->second;
+                }
+            }
+            double replay_speed = 1.0;
+            {
+                const auto name_and_value = command.options.find("replay-speed");
+                if (name_and_value != command.options.end()) {
+                    replay_speed = std::stod(name_and_value->second);
+                }
+            }
+            std::size_t livetrack_buffer_capacity = 1 << 16;
+            {
+                const auto name_and_value = command.options.find("livetrack-buffer");
+                if (name_and_value != command.options.end()) {
+                    livetrack_buffer_capacity = std::stoull(name_and_value->second);
+                    if (livetrack_buffer_capacity == 0) {
+                        throw std::runtime_error("the LiveTrack buffer must contain at least one sample");
+                    }
+                }
+            }
+            auto livetrack_extrapolate = false;
+            {
+                const auto name_and_value = command.options.find("livetrack-overflow");
+                if (name_and_value != command.options.end()) {
+                    if (name_and_value->second == "extrapolate") {
+                        livetrack_extrapolate = true;
+                    } else if (name_and_value->second != "drop") {
+                        throw std::runtime_error("the LiveTrack overflow policy must be 'drop' or 'extrapolate'");
+                    }
+                }
+            }
+            auto livetrack_emit_immediately = false;
+            {
+                const auto name_and_value = command.options.find("livetrack-timing");
+                if (name_and_value != command.options.end()) {
+                    if (name_and_value->second == "extrapolate") {
+                        livetrack_emit_immediately = true;
+                    } else if (name_and_value->second != "interpolate") {
+                        throw std::runtime_error("the LiveTrack timing must be 'interpolate' or 'extrapolate'");
+                    }
+                }
+            }
+            uint64_t sync_period = 0;
+            {
+                const auto name_and_value = command.options.find("sync-period");
+                if (name_and_value != command.options.end()) {
+                    sync_period = std::stoull(name_and_value->second);
+                    if (sync_period > std::numeric_limits<uint32_t>::max()) {
+                        throw std::runtime_error("the sync period must fit in 32 bits");
+                    }
+                }
+            }
+            std::unique_ptr<hibiscus::livetrack_report_logger> livetrack_logger;
+            {
+                const auto name_and_value = command.options.find("livetrack-log");
+                if (name_and_value != command.options.end()) {
+                    {
+                        std::ifstream input(name_and_value->second);
+                        if (input.good() && command.flags.find("force") == command.flags.end()) {
+                            throw std::runtime_error(
+                                std::string("'") + name_and_value->second
+                                + "' already exists (use --force to overwrite it)");
+                        }
+                    }
+                    livetrack_logger.reset(new hibiscus::livetrack_report_logger(name_and_value->second));
+                }
+            }
+            std::string livetrack_video_filename;
+            {
+                const auto name_and_value = command.options.find("livetrack-video");
+                if (name_and_value != command.options.end()) {
+                    if (!livetrack_replay_filename.empty()) {
+                        throw std::runtime_error("the LiveTrack video cannot be recorded while replaying samples");
+                    }
+                    for (const auto& filename :
+                         {name_and_value->second,
+                          name_and_value->second + hibiscus::livetrack_video_layout::index_extension}) {
+                        std::ifstream input(filename);
+                        if (input.good() && command.flags.find("force") == command.flags.end()) {
+                            throw std::runtime_error(
+                                std::string("'") + filename + "' already exists (use --force to overwrite it)");
+                        }
+                    }
+                    livetrack_video_filename = name_and_value->second;
+                }
+            }
             const auto fake_events = command.flags.find("fake-events") != command.flags.end();
+            std::vector<std::string> teensy_paths_or_serials{hibiscus::default_teensy_filename};
+            {
+                const auto name_and_value = command.options.find("teensy");
+                if (name_and_value != command.options.end()) {
+                    teensy_paths_or_serials.clear();
+                    std::stringstream stream(name_and_value->second);
+                    std::string path_or_serial;
+                    while (std::getline(stream, path_or_serial, ',')) {
+                        if (!path_or_serial.empty()) {
+                            teensy_paths_or_serials.push_back(path_or_serial);
+                        }
+                    }
+                    if (teensy_paths_or_serials.empty()) {
+                        throw std::runtime_error("at least one Teensy is required");
+                    }
+                }
+            }
+            auto dmd_mode = hibiscus::teensy_dmd_mode::subframes;
+            {
+                const auto name_and_value = command.options.find("dmd-mode");
+                if (name_and_value != command.options.end()) {
+                    if (name_and_value->second == "expanded") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::expanded_frames;
+                    } else if (name_and_value->second == "compact") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::compact_frames;
+                    } else if (name_and_value->second != "subframes") {
+                        throw std::runtime_error("the DMD mode must be 'subframes', 'expanded' or 'compact'");
+                    }
+                }
+            }
             hummingbird::lightcrafter::ip ip{10, 10, 10, 100};
             {
                 const auto name_and_value = command.options.find("ip");
@@ -109,7 +296,8 @@ int main(int argc, char* argv[]) {
                 }
             }
             hummingbird::lightcrafter lightcrafter(ip);
-            std::unique_ptr<hibiscus::teensy> teensy;
+            std::unique_ptr<hibiscus::reactor> event_loop;
+            std::unique_ptr<hibiscus::teensy_group> teensys;
 
             // merge event handler
             auto merge = tarsier::make_merge<2, sepia::generic_event>(
@@ -131,7 +319,7 @@ int main(int argc, char* argv[]) {
 
             // display observable
             std::atomic<uint64_t> display_event_as_uint64(std::numeric_limits<uint64_t>::max());
-            sepia::fifo<std::string> display_warnings(1 << 16);
+            sepia::fifo<std::pair<std::chrono::steady_clock::time_point, std::string>> display_warnings(1 << 16);
             auto display =
                 hummingbird::make_display(false, 608, 684, 0, fifo_size, [&](hummingbird::display_event display_event) {
                     display_event_as_uint64.store(
@@ -140,15 +328,16 @@ int main(int argc, char* argv[]) {
                             | (static_cast<uint64_t>(display_event.id & 0x7fffffff) << 33),
                         std::memory_order_release);
                     if (display_event.empty_fifo) {
-                        if (!display_warnings.push("empty fifo")) {
+                        if (!display_warnings.push({std::chrono::steady_clock::now(), "empty fifo"})) {
                             throw std::runtime_error("display_warnings fifo overflow");
                         }
                     } else if (
                         display_event.loop_duration > 0
                         && (display_event.loop_duration < 6000 || display_event.loop_duration > 28000)) {
                         if (!display_warnings.push(
-                                std::string("throttling (loop duration: ") + std::to_string(display_event.loop_duration)
-                                + " microseconds)")) {
+                                {std::chrono::steady_clock::now(),
+                                 std::string("throttling (loop duration: ")
+                                     + std::to_string(display_event.loop_duration) + " microseconds)"})) {
                             throw std::runtime_error("display_warnings fifo overflow");
                         }
                     }
@@ -183,11 +372,16 @@ int main(int argc, char* argv[]) {
             // teensy observable
             uint64_t previous_teensy_t = 0;
             auto display_tick_correction = 0ll;
-            sepia::fifo<std::string> livetrack_warnings(1 << 16);
+            sepia::fifo<std::pair<std::chrono::steady_clock::time_point, std::string>> livetrack_warnings(1 << 16);
             std::atomic<uint32_t> livetrack_left_samples(0);
             std::atomic<uint32_t> livetrack_right_samples(0);
-            std::string warning;
-            std::atomic<hibiscus::teensy_event> ab_event;
+            std::pair<std::chrono::steady_clock::time_point, std::string> warning;
+            hibiscus::spsc_queue<hibiscus::teensy_event> sync_events(1 << 10);
+            // the Teensy thread cannot push to livetrack_warnings (single producer), hence drops are counted here
+            std::atomic<uint64_t> sync_events_drops(0);
+            // compact frames' payloads are passed beside their 'g' events
+            hibiscus::teensy_frames teensy_frames(1 << 10);
+            hibiscus::teensy_frame compact_frame;
             auto c_teensy_tick_offset = std::numeric_limits<int64_t>::max();
             auto c_tick = 0ll;
             auto c_will_stop = false;
@@ -215,19 +409,53 @@ int main(int argc, char* argv[]) {
                                                         static_cast<uint8_t>((frame_index >> 24) & 0xff),
                                                     }});
             };
-            teensy = hibiscus::make_teensy_record(
+            auto write_compact_frame_event = [&](uint64_t t, const hibiscus::teensy_frame& teensy_frame) {
+                const auto frame_index = static_cast<uint32_t>((d_tick - d_tick_to_index) * 24);
+                std::vector<uint8_t> bytes{
+                    'g',
+                    static_cast<uint8_t>(frame_index & 0xff),
+                    static_cast<uint8_t>((frame_index >> 8) & 0xff),
+                    static_cast<uint8_t>((frame_index >> 16) & 0xff),
+                    static_cast<uint8_t>((frame_index >> 24) & 0xff),
+                };
+                bytes.reserve(bytes.size() + teensy_frame.deviations_size * 2);
+                for (std::size_t index = 1; index < teensy_frame.subframes(); ++index) {
+                    const auto delay = teensy_frame.subframe_t(t, index) - t;
+                    bytes.push_back(static_cast<uint8_t>(delay & 0xff));
+                    bytes.push_back(static_cast<uint8_t>((delay >> 8) & 0xff));
+                }
+                merge->push<0>(sepia::generic_event{t, bytes});
+            };
+            // warnings from other threads are timestamped with the teensy clock model when it is available,
+            // and with the last teensy event otherwise (timestamps must be monotonic)
+            hibiscus::teensy_clock teensy_clock(256);
+            auto warning_t = [&](std::chrono::steady_clock::time_point host_t) {
+                if (!teensy_clock.ready()) {
+                    return previous_teensy_t;
+                }
+                return std::max(teensy_clock.host_to_teensy(host_t), previous_teensy_t);
+            };
+            // the video index uses the teensy clock model at write time (frames are written a few ms after capture)
+            std::unique_ptr<hibiscus::livetrack_video_logger> livetrack_video_logger;
+            if (!livetrack_video_filename.empty()) {
+                livetrack_video_logger.reset(new hibiscus::livetrack_video_logger(
+                    livetrack_video_filename, [&](std::chrono::steady_clock::time_point host_t) {
+                        return teensy_clock.ready() ? teensy_clock.host_to_teensy(host_t) :
+                                                      hibiscus::livetrack_video_layout::no_teensy_t;
+                    }));
+            }
+            auto teensy_event_queue = hibiscus::make_teensy_event_queue(
                 [&](hibiscus::teensy_event teensy_event) {
                     if (display_warnings.pull(warning)) {
-                        warn(0, previous_teensy_t, warning);
+                        warn(0, warning_t(warning.first), warning.second);
                     }
                     if (livetrack_warnings.pull(warning)) {
-                        warn(0, previous_teensy_t, warning);
+                        warn(0, warning_t(warning.first), warning.second);
+                    }
+                    if (teensy_event.device > 0 && teensy_event.type != 'l' && teensy_event.type != 'r') {
+                        return;
                     }
                     switch (teensy_event.type) {
-                        case 'a':
-                        case 'b':
-                            ab_event.store(teensy_event, std::memory_order_release);
-                            break;
                         case 'c': { // for 'c' events, teensy_event.t is the tick, not the timestamp
                             const auto display_event = display_event_as_uint64.load(std::memory_order_acquire);
                             if (display_event == std::numeric_limits<uint64_t>::max()) {
@@ -297,6 +525,12 @@ int main(int argc, char* argv[]) {
                             break;
                         }
                         case 'd':
+                        case 'g':
+                            // frames are retrieved for every 'g' event, so that the queue does not fill up
+                            if (teensy_event.type == 'g' && !teensy_frames.pull(teensy_event.id, compact_frame)) {
+                                warn(0, teensy_event.t, "compact frame payload dropped");
+                                compact_frame.deviations_size = 0;
+                            }
                             if (d_tick != std::numeric_limits<int64_t>::max()) {
                                 ++d_tick;
                                 if (c_tick != d_tick) {
@@ -346,7 +580,11 @@ int main(int argc, char* argv[]) {
                                 }
                                 if (d_recording) {
                                     e_index = 0;
-                                    write_frame_event(teensy_event.t);
+                                    if (teensy_event.type == 'g') {
+                                        write_compact_frame_event(teensy_event.t, compact_frame);
+                                    } else {
+                                        write_frame_event(teensy_event.t);
+                                    }
                                 } else {
                                     lr_inhibited = true;
                                 }
@@ -354,7 +592,14 @@ int main(int argc, char* argv[]) {
                                     d_stopping_acknowledged.store(true, std::memory_order_release);
                                 }
                                 e_recording = d_recording;
-                                e_index = 1;
+                                if (teensy_event.type == 'g') {
+                                    if (compact_frame.subframes() > 24) {
+                                        warn(0, teensy_event.t, "unexpected 'e' event");
+                                    }
+                                    e_index = static_cast<uint8_t>(compact_frame.subframes());
+                                } else {
+                                    e_index = 1;
+                                }
                             }
                             previous_teensy_t = teensy_event.t;
                             break;
@@ -377,11 +622,20 @@ int main(int argc, char* argv[]) {
                                 wait_for_empty_fifo.store(false, std::memory_order_release);
                                 decoder->stop();
                                 lr_inhibited = true;
-                                merge->push<0>(sepia::generic_event{teensy_event.t, {teensy_event.type}});
+                                if (teensy_event.device == 0) {
+                                    merge->push<0>(sepia::generic_event{teensy_event.t, {teensy_event.type}});
+                                } else {
+                                    merge->push<0>(
+                                        sepia::generic_event{teensy_event.t, {teensy_event.type, teensy_event.device}});
+                                }
+                                const auto device_suffix =
+                                    teensy_event.device == 0 ?
+                                        std::string() :
+                                        std::string(" (teensy ") + std::to_string(teensy_event.device) + ")";
                                 if (teensy_event.type == 'l') {
-                                    std::cout << "    button: \033[31mleft\033[0m\n";
+                                    std::cout << "    button: \033[31mleft\033[0m" + device_suffix + "\n";
                                 } else {
-                                    std::cout << "    button: \033[32mright\033[0m\n";
+                                    std::cout << "    button: \033[32mright\033[0m" + device_suffix + "\n";
                                 }
                                 std::cout.flush();
                             }
@@ -395,158 +649,332 @@ int main(int argc, char* argv[]) {
                     pipeline_exception = exception;
                     wait_for_empty_fifo.store(false, std::memory_order_release);
                     running.store(false, std::memory_order_release);
+                },
+                1 << 16);
+            if (command.flags.find("reactor") != command.flags.end()) {
+                event_loop = hibiscus::make_reactor([&](std::exception_ptr exception) {
+                    pipeline_exception = exception;
+                    wait_for_empty_fifo.store(false, std::memory_order_release);
+                    running.store(false, std::memory_order_release);
+                });
+            }
+            teensys = hibiscus::make_teensy_group(
+                teensy_paths_or_serials,
+                [&](hibiscus::teensy_event teensy_event) {
+                    if (teensy_event.type == 'a' || teensy_event.type == 'b' || teensy_event.type == 's') {
+                        if (!sync_events.push(teensy_event)) {
+                            sync_events_drops.fetch_add(1, std::memory_order_release);
+                        }
+                    } else {
+                        teensy_event_queue->push(teensy_event);
+                    }
+                },
+                [&](std::exception_ptr exception) {
+                    pipeline_exception = exception;
+                    wait_for_empty_fifo.store(false, std::memory_order_release);
+                    running.store(false, std::memory_order_release);
+                },
+                event_loop.get(),
+                dmd_mode,
+                &teensy_clock,
+                &teensy_frames);
+
+            // gaze classifiers (events are timestamped with the sample which ended them)
+            uint64_t gaze_t = 0;
+            uint64_t fixations = 0;
+            uint64_t saccades = 0;
+            uint64_t blinks = 0;
+            auto make_eye_classifier = [&](uint8_t eye) {
+                return hibiscus::make_gaze_classifier([&, eye](hibiscus::gaze_event gaze_event) {
+                    merge->push<1>(sepia::generic_event{gaze_t, hibiscus::gaze_event_to_bytes(gaze_event, eye)});
+                    switch (gaze_event.type) {
+                        case hibiscus::gaze_event_type::fixation:
+                            ++fixations;
+                            break;
+                        case hibiscus::gaze_event_type::saccade:
+                            ++saccades;
+                            break;
+                        case hibiscus::gaze_event_type::blink:
+                            ++blinks;
+                            break;
+                    }
                 });
+            };
+            auto left_gaze_classifier = make_eye_classifier(0);
+            auto right_gaze_classifier = make_eye_classifier(1);
+
+            // livetrack samples conversion and output
+            auto write_livetrack_data = [&](const hibiscus::livetrack_data& livetrack_data, uint64_t t) {
+                gaze_t = t;
+                if (livetrack_data.left.has_pupil && livetrack_data.left.has_glint_1) {
+                    const auto point = hibiscus::projection(
+                        calibrations.left.matrix,
+                        hibiscus::eye({static_cast<double>(livetrack_data.left.pupil_x)
+                                           - livetrack_data.left.glint_1_x,
+                                       static_cast<double>(livetrack_data.left.pupil_y)
+                                           - livetrack_data.left.glint_1_y}));
+                    const uint64_t x = *reinterpret_cast<const uint64_t*>(&std::get<0>(point));
+                    const uint64_t y = *reinterpret_cast<const uint64_t*>(&std::get<1>(point));
+                    merge->push<1>(sepia::generic_event{
+                        t,
+                        {'a',
+                         static_cast<uint8_t>(x & 0xff),
+                         static_cast<uint8_t>((x >> 8) & 0xff),
+                         static_cast<uint8_t>((x >> 16) & 0xff),
+                         static_cast<uint8_t>((x >> 24) & 0xff),
+                         static_cast<uint8_t>((x >> 32) & 0xff),
+                         static_cast<uint8_t>((x >> 40) & 0xff),
+                         static_cast<uint8_t>((x >> 48) & 0xff),
+                         static_cast<uint8_t>((x >> 56) & 0xff),
+                         static_cast<uint8_t>(y & 0xff),
+                         static_cast<uint8_t>((y >> 8) & 0xff),
+                         static_cast<uint8_t>((y >> 16) & 0xff),
+                         static_cast<uint8_t>((y >> 24) & 0xff),
+                         static_cast<uint8_t>((y >> 32) & 0xff),
+                         static_cast<uint8_t>((y >> 40) & 0xff),
+                         static_cast<uint8_t>((y >> 48) & 0xff),
+                         static_cast<uint8_t>((y >> 56) & 0xff),
+                         static_cast<uint8_t>(livetrack_data.left.major_axis & 0xff),
+                         static_cast<uint8_t>((livetrack_data.left.major_axis >> 8) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.left.major_axis >> 16) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.left.major_axis >> 24) & 0xff),
+                         static_cast<uint8_t>(livetrack_data.left.minor_axis & 0xff),
+                         static_cast<uint8_t>((livetrack_data.left.minor_axis >> 8) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.left.minor_axis >> 16) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.left.minor_axis >> 24) & 0xff)}});
+                    livetrack_left_samples.fetch_add(1, std::memory_order_release);
+                    left_gaze_classifier->push(t, std::get<0>(point), std::get<1>(point));
+                } else if (!livetrack_data.left.has_pupil) {
+                    left_gaze_classifier->push_lost(t);
+                }
+                if (livetrack_data.right.has_pupil && livetrack_data.right.has_glint_1) {
+                    const auto point = hibiscus::projection(
+                        calibrations.right.matrix,
+                        hibiscus::eye({static_cast<double>(livetrack_data.right.pupil_x)
+                                           - livetrack_data.right.glint_1_x,
+                                       static_cast<double>(livetrack_data.right.pupil_y)
+                                           - livetrack_data.right.glint_1_y}));
+                    const uint64_t x = *reinterpret_cast<const uint64_t*>(&std::get<0>(point));
+                    const uint64_t y = *reinterpret_cast<const uint64_t*>(&std::get<1>(point));
+                    merge->push<1>(sepia::generic_event{
+                        t,
+                        {'b',
+                         static_cast<uint8_t>(x & 0xff),
+                         static_cast<uint8_t>((x >> 8) & 0xff),
+                         static_cast<uint8_t>((x >> 16) & 0xff),
+                         static_cast<uint8_t>((x >> 24) & 0xff),
+                         static_cast<uint8_t>((x >> 32) & 0xff),
+                         static_cast<uint8_t>((x >> 40) & 0xff),
+                         static_cast<uint8_t>((x >> 48) & 0xff),
+                         static_cast<uint8_t>((x >> 56) & 0xff),
+                         static_cast<uint8_t>(y & 0xff),
+                         static_cast<uint8_t>((y >> 8) & 0xff),
+                         static_cast<uint8_t>((y >> 16) & 0xff),
+                         static_cast<uint8_t>((y >> 24) & 0xff),
+                         static_cast<uint8_t>((y >> 32) & 0xff),
+                         static_cast<uint8_t>((y >> 40) & 0xff),
+                         static_cast<uint8_t>((y >> 48) & 0xff),
+                         static_cast<uint8_t>((y >> 56) & 0xff),
+                         static_cast<uint8_t>(livetrack_data.right.major_axis & 0xff),
+                         static_cast<uint8_t>((livetrack_data.right.major_axis >> 8) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.right.major_axis >> 16) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.right.major_axis >> 24) & 0xff),
+                         static_cast<uint8_t>(livetrack_data.right.minor_axis & 0xff),
+                         static_cast<uint8_t>((livetrack_data.right.minor_axis >> 8) & 0xff),
+                         static_cast<uint8_t>((livetrack_data.right.minor_axis >> 16) & 0xff),
+                         static_cast<uint8_t>(
+                             (livetrack_data.right.minor_axis >> 24) & 0xff)}});
+                    livetrack_right_samples.fetch_add(1, std::memory_order_release);
+                    right_gaze_classifier->push(t, std::get<0>(point), std::get<1>(point));
+                } else if (!livetrack_data.right.has_pupil) {
+                    right_gaze_classifier->push_lost(t);
+                }
+            };
 
             // livetrack observable
+            // sync edges are matched in order: each LiveTrack io bit 22 transition with the Teensy message
+            // timestamping the corresponding BNC edge, either an echo ('a' or 'b') or a periodic edge ('s')
             std::atomic_bool livetrack_ready(false);
             auto is_livetrack_high = false;
-            std::vector<hibiscus::livetrack_data> livetrack_data_events;
-            livetrack_data_events.reserve(1 << 16);
-            std::size_t past_the_edge_index = 0;
-            uint64_t livetrack_previous_reference_t = 0;
-            uint64_t livetrack_previous_t = 0;
+            hibiscus::ring_buffer<hibiscus::livetrack_data> livetrack_data_events(livetrack_buffer_capacity);
+            hibiscus::livetrack_clock livetrack_clock(64);
+            hibiscus::latency_histogram livetrack_latency;
+            hibiscus::latency_histogram livetrack_hold;
+            hibiscus::ring_buffer<livetrack_edge> livetrack_edges(256);
+            hibiscus::ring_buffer<hibiscus::teensy_event> teensy_edges(256);
+            auto livetrack_has_previous_sample = false;
+            uint64_t livetrack_previous_sample_t = 0;
+            uint64_t livetrack_previous_teensy_t = 0;
+            auto livetrack_overflowing = false;
+            uint64_t livetrack_overflows = 0;
+            uint64_t sync_edges_matched = 0;
+            uint64_t sync_edges_unmatched = 0;
+            uint64_t sync_events_reported_drops = 0;
+            std::chrono::steady_clock::time_point sync_first_match_t;
+            std::chrono::steady_clock::time_point sync_last_match_t;
             std::atomic_bool livetrack_stopping_acknowledged(false);
-            auto livetrack_data_observable = hibiscus::make_livetrack_data_observable(
+            auto livetrack_warn = [&](const std::string& message) {
+                if (!livetrack_warnings.push({std::chrono::steady_clock::now(), message})) {
+                    throw std::runtime_error("livetrack_warnings fifo overflow");
+                }
+            };
+            // refits may move the conversion backwards, hence the clamp to keep the channel sorted
+            auto livetrack_to_teensy = [&](uint64_t livetrack_t) {
+                livetrack_previous_teensy_t =
+                    std::max(livetrack_clock.livetrack_to_teensy(livetrack_t), livetrack_previous_teensy_t);
+                return livetrack_previous_teensy_t;
+            };
+            auto livetrack_data_observable = hibiscus::make_livetrack_data_source(
                 [&](hibiscus::livetrack_data livetrack_data) {
-                    livetrack_data.t -= 1000; // statistical estimator for the actual timestamp
-                    livetrack_data_events.push_back(livetrack_data);
-                    if (is_livetrack_high != (((livetrack_data.io >> 22) & 1) == 1)) {
+                    const auto previous_sample_t = livetrack_previous_sample_t;
+                    livetrack_previous_sample_t = livetrack_data.t;
+                    if (!livetrack_has_previous_sample) {
+                        // an edge cannot be bracketed without a previous sample, the first sample sets the level
+                        livetrack_has_previous_sample = true;
+                        is_livetrack_high = ((livetrack_data.io >> 22) & 1) == 1;
+                    } else if (is_livetrack_high != (((livetrack_data.io >> 22) & 1) == 1)) {
                         if (fake_events && std::rand() < RAND_MAX / 100) {
-                            teensy->send('f');
+                            teensys->device(0).send('f');
                         }
-                        past_the_edge_index = livetrack_data_events.size();
                         is_livetrack_high = !is_livetrack_high;
+                        if (livetrack_edges.full()) {
+                            livetrack_edges.pop_front();
+                            ++sync_edges_unmatched;
+                        }
+                        livetrack_edges.push_back(livetrack_edge{
+                            hibiscus::livetrack_clock::edge_t(previous_sample_t, livetrack_data.t),
+                            livetrack_data.t,
+                            is_livetrack_high,
+                            std::chrono::steady_clock::now()});
                     }
-                    if (past_the_edge_index != 0) {
-                        auto teensy_event = ab_event.load(std::memory_order_acquire);
-                        if (teensy_event.type != 0) {
-                            if ((teensy_event.type == 'a' && is_livetrack_high)
-                                || (teensy_event.type == 'b' && !is_livetrack_high)) {
-                                if (livetrack_ready.load(std::memory_order_acquire)) {
-                                    const auto slope =
-                                        static_cast<double>(teensy_event.t - livetrack_previous_reference_t)
-                                        / static_cast<double>(
-                                            livetrack_data_events[past_the_edge_index - 1].t - livetrack_previous_t);
-                                    const auto intercept =
-                                        livetrack_previous_reference_t - slope * livetrack_previous_t;
-                                    for (std::size_t index = 0; index < past_the_edge_index; ++index) {
-                                        auto livetrack_data = livetrack_data_events[index];
-                                        const auto t = static_cast<uint64_t>(slope * livetrack_data.t + intercept);
-                                        if (livetrack_data.left.has_pupil && livetrack_data.left.has_glint_1) {
-                                            const auto point = hibiscus::projection(
-                                                calibrations.left.matrix,
-                                                hibiscus::eye({static_cast<double>(livetrack_data.left.pupil_x)
-                                                                   - livetrack_data.left.glint_1_x,
-                                                               static_cast<double>(livetrack_data.left.pupil_y)
-                                                                   - livetrack_data.left.glint_1_y}));
-                                            const uint64_t x = *reinterpret_cast<const uint64_t*>(&std::get<0>(point));
-                                            const uint64_t y = *reinterpret_cast<const uint64_t*>(&std::get<1>(point));
-                                            merge->push<1>(sepia::generic_event{
-                                                t,
-                                                {'a',
-                                                 static_cast<uint8_t>(x & 0xff),
-                                                 static_cast<uint8_t>((x >> 8) & 0xff),
-                                                 static_cast<uint8_t>((x >> 16) & 0xff),
-                                                 static_cast<uint8_t>((x >> 24) & 0xff),
-                                                 static_cast<uint8_t>((x >> 32) & 0xff),
-                                                 static_cast<uint8_t>((x >> 40) & 0xff),
-                                                 static_cast<uint8_t>((x >> 48) & 0xff),
-                                                 static_cast<uint8_t>((x >> 56) & 0xff),
-                                                 static_cast<uint8_t>(y & 0xff),
-                                                 static_cast<uint8_t>((y >> 8) & 0xff),
-                                                 static_cast<uint8_t>((y >> 16) & 0xff),
-                                                 static_cast<uint8_t>((y >> 24) & 0xff),
-                                                 static_cast<uint8_t>((y >> 32) & 0xff),
-                                                 static_cast<uint8_t>((y >> 40) & 0xff),
-                                                 static_cast<uint8_t>((y >> 48) & 0xff),
-                                                 static_cast<uint8_t>((y >> 56) & 0xff),
-                                                 static_cast<uint8_t>(livetrack_data.left.major_axis & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.left.major_axis >> 8) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.left.major_axis >> 16) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.left.major_axis >> 24) & 0xff),
-                                                 static_cast<uint8_t>(livetrack_data.left.minor_axis & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.left.minor_axis >> 8) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.left.minor_axis >> 16) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.left.minor_axis >> 24) & 0xff)}});
-                                            livetrack_left_samples.fetch_add(1, std::memory_order_release);
-                                        }
-                                        if (livetrack_data.right.has_pupil && livetrack_data.right.has_glint_1) {
-                                            const auto point = hibiscus::projection(
-                                                calibrations.right.matrix,
-                                                hibiscus::eye({static_cast<double>(livetrack_data.right.pupil_x)
-                                                                   - livetrack_data.right.glint_1_x,
-                                                               static_cast<double>(livetrack_data.right.pupil_y)
-                                                                   - livetrack_data.right.glint_1_y}));
-                                            const uint64_t x = *reinterpret_cast<const uint64_t*>(&std::get<0>(point));
-                                            const uint64_t y = *reinterpret_cast<const uint64_t*>(&std::get<1>(point));
-                                            merge->push<1>(sepia::generic_event{
-                                                t,
-                                                {'b',
-                                                 static_cast<uint8_t>(x & 0xff),
-                                                 static_cast<uint8_t>((x >> 8) & 0xff),
-                                                 static_cast<uint8_t>((x >> 16) & 0xff),
-                                                 static_cast<uint8_t>((x >> 24) & 0xff),
-                                                 static_cast<uint8_t>((x >> 32) & 0xff),
-                                                 static_cast<uint8_t>((x >> 40) & 0xff),
-                                                 static_cast<uint8_t>((x >> 48) & 0xff),
-                                                 static_cast<uint8_t>((x >> 56) & 0xff),
-                                                 static_cast<uint8_t>(y & 0xff),
-                                                 static_cast<uint8_t>((y >> 8) & 0xff),
-                                                 static_cast<uint8_t>((y >> 16) & 0xff),
-                                                 static_cast<uint8_t>((y >> 24) & 0xff),
-                                                 static_cast<uint8_t>((y >> 32) & 0xff),
-                                                 static_cast<uint8_t>((y >> 40) & 0xff),
-                                                 static_cast<uint8_t>((y >> 48) & 0xff),
-                                                 static_cast<uint8_t>((y >> 56) & 0xff),
-                                                 static_cast<uint8_t>(livetrack_data.right.major_axis & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.right.major_axis >> 8) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.right.major_axis >> 16) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.right.major_axis >> 24) & 0xff),
-                                                 static_cast<uint8_t>(livetrack_data.right.minor_axis & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.right.minor_axis >> 8) & 0xff),
-                                                 static_cast<uint8_t>((livetrack_data.right.minor_axis >> 16) & 0xff),
-                                                 static_cast<uint8_t>(
-                                                     (livetrack_data.right.minor_axis >> 24) & 0xff)}});
-                                            livetrack_right_samples.fetch_add(1, std::memory_order_release);
-                                        }
-                                    }
-                                } else {
-                                    livetrack_ready.store(true, std::memory_order_release);
-                                }
-                                livetrack_previous_reference_t = teensy_event.t;
-                                livetrack_previous_t = livetrack_data_events[past_the_edge_index - 1].t;
-                                merge->push<1>(sepia::generic_event{
-                                    teensy_event.t,
-                                    {'c',
-                                     static_cast<uint8_t>(livetrack_previous_reference_t & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 8) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 16) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 24) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 32) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 40) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 48) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_reference_t >> 56) & 0xff),
-                                     static_cast<uint8_t>(livetrack_previous_t & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 8) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 16) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 24) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 32) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 40) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 48) & 0xff),
-                                     static_cast<uint8_t>((livetrack_previous_t >> 56) & 0xff)}});
-                                livetrack_data_events.erase(
-                                    livetrack_data_events.begin(),
-                                    std::next(livetrack_data_events.begin(), past_the_edge_index));
-                                past_the_edge_index = 0;
-                                teensy->send(teensy_event.type == 'a' ? 'b' : 'a');
-                                if (stopping.load(std::memory_order_acquire)) {
-                                    livetrack_stopping_acknowledged.store(true, std::memory_order_release);
-                                }
-                            } else {
-                                if (!livetrack_warnings.push("livetrack edge type and teensy event mismatch")) {
-                                    throw std::runtime_error("livetrack_warnings fifo overflow");
-                                }
+                    if (livetrack_emit_immediately && livetrack_clock.ready()) {
+                        // the samples buffered until the clock became ready precede the current one
+                        while (!livetrack_data_events.empty()) {
+                            const auto& oldest_livetrack_data = livetrack_data_events.front();
+                            write_livetrack_data(oldest_livetrack_data, livetrack_to_teensy(oldest_livetrack_data.t));
+                            livetrack_data_events.pop_front();
+                        }
+                        write_livetrack_data(livetrack_data, livetrack_to_teensy(livetrack_data.t));
+                    } else {
+                        if (livetrack_data_events.full()) {
+                            // the sync edge echo is late or lost, the oldest sample is written with the current clock
+                            // fit (extrapolate policy, once synchronized) or dropped
+                            if (!livetrack_overflowing) {
+                                livetrack_overflowing = true;
+                                livetrack_warn(
+                                    livetrack_extrapolate && livetrack_clock.ready() ?
+                                        "livetrack buffer overflow, extrapolating the oldest samples' timestamps" :
+                                        "livetrack buffer overflow, dropping the oldest samples");
+                            }
+                            ++livetrack_overflows;
+                            if (livetrack_extrapolate && livetrack_clock.ready()) {
+                                const auto& oldest_livetrack_data = livetrack_data_events.front();
+                                write_livetrack_data(
+                                    oldest_livetrack_data, livetrack_to_teensy(oldest_livetrack_data.t));
+                            }
+                            livetrack_data_events.pop_front();
+                        }
+                        livetrack_data_events.push_back(livetrack_data);
+                    }
+                    {
+                        // a dropped sync edge shifts the in-order matching, hence it is reported immediately
+                        const auto drops = sync_events_drops.load(std::memory_order_acquire);
+                        if (drops > sync_events_reported_drops) {
+                            livetrack_warn(
+                                std::to_string(drops - sync_events_reported_drops)
+                                + " teensy sync edges dropped (queue overflow)");
+                            sync_events_reported_drops = drops;
+                        }
+                        hibiscus::teensy_event teensy_edge;
+                        while (sync_events.pull(teensy_edge)) {
+                            if (teensy_edges.full()) {
+                                teensy_edges.pop_front();
+                                ++sync_edges_unmatched;
                             }
+                            teensy_edges.push_back(teensy_edge);
+                        }
+                    }
+                    while (!livetrack_edges.empty() && !teensy_edges.empty()) {
+                        const auto current_livetrack_edge = livetrack_edges.front();
+                        const auto teensy_edge = teensy_edges.front();
+                        if (sync_period > 0 && livetrack_clock.ready()) {
+                            // with several edges in flight, an edge missed by either side is detected by the clock
+                            const auto expected_t =
+                                livetrack_clock.livetrack_to_teensy(static_cast<uint64_t>(current_livetrack_edge.t));
+                            if (teensy_edge.t + sync_period / 2 < expected_t) {
+                                teensy_edges.pop_front();
+                                ++sync_edges_unmatched;
+                                continue;
+                            }
+                            if (teensy_edge.t > expected_t + sync_period / 2) {
+                                livetrack_edges.pop_front();
+                                ++sync_edges_unmatched;
+                                continue;
+                            }
+                        }
+                        const auto is_teensy_high =
+                            teensy_edge.type == 's' ? (teensy_edge.id & 1) == 1 : teensy_edge.type == 'a';
+                        if (is_teensy_high != current_livetrack_edge.is_high) {
+                            livetrack_warn("livetrack edge type and teensy event mismatch");
+                            teensy_edges.pop_front();
+                            ++sync_edges_unmatched;
+                            continue;
+                        }
+                        livetrack_edges.pop_front();
+                        teensy_edges.pop_front();
+                        if (!livetrack_clock.add(current_livetrack_edge.t, teensy_edge.t)) {
+                            livetrack_warn(
+                                std::string("livetrack sync edge rejected (")
+                                + std::to_string(static_cast<int64_t>(livetrack_clock.residual())) + " us residual)");
+                        }
+                        if (livetrack_replay_filename.empty() && teensy_clock.ready()) {
+                            livetrack_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                current_livetrack_edge.host_t - teensy_clock.teensy_to_host(teensy_edge.t)));
+                        }
+                        while (!livetrack_data_events.empty()
+                               && livetrack_data_events.front().t <= current_livetrack_edge.after_t) {
+                            if (livetrack_clock.ready()) {
+                                const auto& oldest_livetrack_data = livetrack_data_events.front();
+                                livetrack_hold.add(
+                                    std::chrono::microseconds(livetrack_data.t - oldest_livetrack_data.t));
+                                write_livetrack_data(
+                                    oldest_livetrack_data, livetrack_to_teensy(oldest_livetrack_data.t));
+                            }
+                            livetrack_data_events.pop_front();
+                        }
+                        const auto edge_t = static_cast<uint64_t>(current_livetrack_edge.t);
+                        livetrack_previous_teensy_t = std::max(teensy_edge.t, livetrack_previous_teensy_t);
+                        merge->push<1>(sepia::generic_event{
+                            livetrack_previous_teensy_t,
+                            {'c',
+                             static_cast<uint8_t>(teensy_edge.t & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 8) & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 16) & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 24) & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 32) & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 40) & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 48) & 0xff),
+                             static_cast<uint8_t>((teensy_edge.t >> 56) & 0xff),
+                             static_cast<uint8_t>(edge_t & 0xff),
+                             static_cast<uint8_t>((edge_t >> 8) & 0xff),
+                             static_cast<uint8_t>((edge_t >> 16) & 0xff),
+                             static_cast<uint8_t>((edge_t >> 24) & 0xff),
+                             static_cast<uint8_t>((edge_t >> 32) & 0xff),
+                             static_cast<uint8_t>((edge_t >> 40) & 0xff),
+                             static_cast<uint8_t>((edge_t >> 48) & 0xff),
+                             static_cast<uint8_t>((edge_t >> 56) & 0xff)}});
+                        sync_last_match_t = std::chrono::steady_clock::now();
+                        if (sync_edges_matched == 0) {
+                            sync_first_match_t = sync_last_match_t;
+                        }
+                        ++sync_edges_matched;
+                        livetrack_overflowing = false;
+                        livetrack_ready.store(true, std::memory_order_release);
+                        if (sync_period == 0) {
+                            teensys->device(0).send(teensy_edge.type == 'a' ? 'b' : 'a');
+                        }
+                        if (stopping.load(std::memory_order_acquire)) {
+                            livetrack_stopping_acknowledged.store(true, std::memory_order_release);
                         }
                     }
                 },
@@ -554,7 +982,35 @@ int main(int argc, char* argv[]) {
                     pipeline_exception = exception;
                     running.store(false, std::memory_order_release);
                     wait_for_empty_fifo.store(false, std::memory_order_release);
-                });
+                },
+                event_loop.get(),
+                livetrack_replay_filename,
+                replay_speed,
+                livetrack_logger.get());
+
+            // the LiveTrack video is recorded without decoding
+            auto handle_livetrack_frame = [](const std::vector<uint8_t>&, std::chrono::steady_clock::time_point) {};
+            auto handle_livetrack_video_exception = [&](std::exception_ptr exception) {
+                pipeline_exception = exception;
+                running.store(false, std::memory_order_release);
+                wait_for_empty_fifo.store(false, std::memory_order_release);
+            };
+            std::unique_ptr<hibiscus::livetrack_video_observable<
+                decltype(handle_livetrack_frame),
+                decltype(handle_livetrack_video_exception)>>
+                livetrack_video_observable;
+            if (livetrack_video_logger) {
+                hibiscus::livetrack_video_output livetrack_video_output;
+                livetrack_video_output.decode = false;
+                livetrack_video_observable = hibiscus::make_livetrack_video_observable(
+                    "/dev/video0",
+                    handle_livetrack_frame,
+                    handle_livetrack_video_exception,
+                    event_loop.get(),
+                    4,
+                    livetrack_video_output,
+                    livetrack_video_logger.get());
+            }
 
             // play loop
             std::thread play_loop([&]() {
@@ -588,8 +1044,17 @@ int main(int argc, char* argv[]) {
             });
 
             // synchronize the livetrack
+            // the first sync edge must be generated once the acquisition restarted, so that it is bracketed by samples
             livetrack_data_observable->start();
-            teensy->send('a');
+            while (livetrack_data_observable->state() != hibiscus::livetrack_state::running
+                   && running.load(std::memory_order_acquire)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            if (sync_period > 0) {
+                teensys->device(0).send_value('s', static_cast<uint32_t>(sync_period));
+            } else {
+                teensys->device(0).send('a');
+            }
             while (!livetrack_ready.load(std::memory_order_acquire)) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(20));
             }
@@ -599,10 +1064,66 @@ int main(int argc, char* argv[]) {
             running.store(false, std::memory_order_release);
             decoder->stop();
             play_loop.join();
+            const auto livetrack_statistics = livetrack_data_observable->statistics().to_string();
+            livetrack_data_observable.reset();
+            livetrack_video_observable.reset();
+            const auto teensy_round_trip = teensys->device(0).round_trip_histogram().to_string();
+            teensys.reset();
+            event_loop.reset();
+            const auto teensy_overflows = teensy_event_queue->overflows();
+            const auto teensy_high_water_mark = teensy_event_queue->high_water_mark();
+            const auto teensy_capacity = teensy_event_queue->capacity();
+            teensy_event_queue.reset();
             if (pipeline_exception) {
                 std::rethrow_exception(pipeline_exception);
             }
-            livetrack_data_observable.reset();
-            teensy.reset();
+            if (teensy_overflows > 0) {
+                warn(
+                    0, previous_teensy_t, std::to_string(teensy_overflows) + " teensy events dropped (queue overflow)");
+            }
+            std::cout << std::string("teensy queue: ") + std::to_string(teensy_high_water_mark) + " / "
+                             + std::to_string(teensy_capacity) + " events at most\n";
+            std::cout << std::string("teensy sync round trip: ") + teensy_round_trip + "\n";
+            std::cout << std::string("livetrack: ") + livetrack_statistics + "\n";
+            std::cout << std::string("livetrack buffer: ") + std::to_string(livetrack_data_events.high_water_mark())
+                             + " / " + std::to_string(livetrack_data_events.capacity()) + " samples at most, "
+                             + std::to_string(livetrack_overflows) + " overflows\n";
+            if (livetrack_video_logger) {
+                std::cout << std::string("livetrack video log: ") + std::to_string(livetrack_video_logger->frames())
+                                 + " frames, " + std::to_string(livetrack_video_logger->dropped()) + " dropped\n";
+            }
+            if (livetrack_clock.ready()) {
+                std::cout << std::string("livetrack clock: ") + std::to_string(livetrack_clock.drift()) + " ppm drift, "
+                                 + std::to_string(livetrack_clock.jitter()) + " us jitter, "
+                                 + std::to_string(livetrack_clock.rejected_edges()) + " / "
+                                 + std::to_string(livetrack_clock.edges()) + " edges rejected\n";
+            }
+            if (livetrack_latency.total() > 0) {
+                std::cout << std::string("livetrack sync latency: ") + livetrack_latency.to_string() + "\n";
+            }
+            {
+                const auto sync_duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                                               sync_last_match_t - sync_first_match_t)
+                                               .count();
+                std::cout << std::string("livetrack sync: ") + std::to_string(sync_edges_matched) + " edges ("
+                                 + std::to_string(
+                                     sync_duration > 0 ? (sync_edges_matched - 1) * 1e6 / sync_duration : 0.0)
+                                 + " per second), " + std::to_string(sync_edges_unmatched) + " unmatched, "
+                                 + std::to_string(sync_events.overflows()) + " dropped\n";
+            }
+            if (livetrack_hold.total() > 0) {
+                std::cout << std::string("livetrack hold time: ") + livetrack_hold.to_string() + "\n";
+            }
+            std::cout << std::string("gaze: ") + std::to_string(fixations) + " fixations, " + std::to_string(saccades)
+                             + " saccades, " + std::to_string(blinks) + " blinks\n";
+            if (livetrack_logger) {
+                std::cout << std::string("livetrack log: ") + std::to_string(livetrack_logger->records())
+                                 + " reports, " + std::to_string(livetrack_logger->dropped()) + " dropped\n";
+            }
+            if (teensy_clock.ready()) {
+                std::cout << std::string("teensy clock: drift ") + std::to_string(teensy_clock.drift())
+                                 + " ppm, jitter " + std::to_string(teensy_clock.jitter()) + " us\n";
+            }
+            std::cout.flush();
         });
 }
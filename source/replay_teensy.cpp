@@ -0,0 +1,183 @@
+#include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
+#include "pty_teensy.hpp"
+#include "teensy.hpp"
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+/// replay_teensy_running is cleared by the interrupt signal handler.
+std::atomic_bool replay_teensy_running(true);
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "replay_teensy decodes the byte stream of a Teensy running the record firmware, and prints statistics",
+            "Syntax: ./replay_teensy [options] /path/to/input",
+            "The input is either a byte log written by emulate_teensy --output, which is played back",
+            "as fast as possible through a pseudo-terminal, or a Teensy (or emulate_teensy) device,",
+            "which is read until the duration elapses or the program is interrupted.",
+            "The bytes count starts with the reset reply.",
+            "Available options:",
+            "    -m [mode], --dmd-mode [mode]          sets the DMD protocol requested to the Teensy, one of:",
+            "                                              subframes (one Teensy message per subframe)",
+            "                                              expanded (one Teensy message per frame,",
+            "                                                  one event per subframe)",
+            "                                              compact (one Teensy message and one event per frame)",
+            "                                              defaults to subframes",
+            "    -d [duration], --duration [duration]  sets the device reading duration in seconds",
+            "                                              ignored when playing back a log",
+            "                                              defaults to 0 (until interrupted)",
+            "    -e, --events                          prints the decoded events (timestamp and type, one per line)",
+            "                                              the statistics are then printed to the standard error",
+            "    -h, --help                            shows this help message",
+        },
+        argc,
+        argv,
+        1,
+        {{"dmd-mode", {"m"}}, {"duration", {"d"}}},
+        {{"events", {"e"}}},
+        [](pontella::command command) {
+            auto dmd_mode = hibiscus::teensy_dmd_mode::subframes;
+            {
+                const auto name_and_value = command.options.find("dmd-mode");
+                if (name_and_value != command.options.end()) {
+                    if (name_and_value->second == "expanded") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::expanded_frames;
+                    } else if (name_and_value->second == "compact") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::compact_frames;
+                    } else if (name_and_value->second != "subframes") {
+                        throw std::runtime_error("the DMD mode must be 'subframes', 'expanded' or 'compact'");
+                    }
+                }
+            }
+            auto duration = 0.0;
+            {
+                const auto name_and_value = command.options.find("duration");
+                if (name_and_value != command.options.end()) {
+                    duration = std::stod(name_and_value->second);
+                    if (duration < 0) {
+                        throw std::runtime_error("the duration must be positive");
+                    }
+                }
+            }
+            const auto print_events = command.flags.find("events") != command.flags.end();
+            auto& statistics = print_events ? std::cerr : std::cout;
+            const auto& filename = command.arguments.front();
+            struct stat status;
+            if (stat(filename.c_str(), &status) < 0) {
+                throw std::runtime_error(std::string("'") + filename + "' does not exist");
+            }
+            const auto playback = !S_ISCHR(status.st_mode);
+            std::vector<uint8_t> log;
+            if (playback) {
+                std::ifstream input(filename, std::ifstream::binary);
+                if (!input.good()) {
+                    throw std::runtime_error(std::string("'") + filename + "' could not be open for reading");
+                }
+                log.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+            }
+            std::signal(SIGINT, [](int) { replay_teensy_running.store(false, std::memory_order_release); });
+
+            // the pseudo-terminal is only used to play back logs
+            std::unique_ptr<hibiscus::pty_teensy> emulated_teensy(playback ? new hibiscus::pty_teensy : nullptr);
+            // the handshake runs in the teensy constructor, hence the log is played back by another thread
+            std::atomic_bool played_back(false);
+            std::exception_ptr playback_exception;
+            std::thread playback_loop;
+            if (playback) {
+                playback_loop = std::thread([&]() {
+                    try {
+                        emulated_teensy->replay(log, replay_teensy_running);
+                    } catch (...) {
+                        playback_exception = std::current_exception();
+                    }
+                    played_back.store(true, std::memory_order_release);
+                });
+            }
+            std::exception_ptr teensy_exception;
+            const auto begin = std::chrono::steady_clock::now();
+            std::array<uint64_t, 256> type_to_count;
+            type_to_count.fill(0);
+            uint64_t events = 0;
+            uint64_t frames = 0;
+            uint64_t first_t = 0;
+            uint64_t last_t = 0;
+            std::unique_ptr<hibiscus::teensy> teensy;
+            try {
+                teensy = hibiscus::make_teensy_record(
+                    [&](hibiscus::teensy_event teensy_event) {
+                        if (events == 0) {
+                            first_t = teensy_event.t;
+                        }
+                        ++events;
+                        ++type_to_count[teensy_event.type];
+                        if (print_events) {
+                            std::cout << teensy_event.t << ' ' << teensy_event.type << '\n';
+                        }
+                        if (teensy_event.type == 'd' || teensy_event.type == 'g') {
+                            ++frames;
+                        }
+                        // ticks ('c') carry a frame index instead of a timestamp
+                        if (teensy_event.type != 'c') {
+                            last_t = std::max(last_t, teensy_event.t);
+                        }
+                    },
+                    [&](std::exception_ptr exception) {
+                        teensy_exception = exception;
+                        replay_teensy_running.store(false, std::memory_order_release);
+                    },
+                    playback ? emulated_teensy->filename() : filename,
+                    nullptr,
+                    dmd_mode);
+            } catch (...) {
+                replay_teensy_running.store(false, std::memory_order_release);
+                if (playback) {
+                    playback_loop.join();
+                }
+                throw;
+            }
+            while (replay_teensy_running.load(std::memory_order_acquire)
+                   && !played_back.load(std::memory_order_acquire)
+                   && (playback || duration == 0
+                       || std::chrono::steady_clock::now() - begin
+                              < std::chrono::microseconds(static_cast<int64_t>(duration * 1e6)))) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            // the destructor flushes the buffered events
+            teensy.reset();
+            if (playback) {
+                replay_teensy_running.store(false, std::memory_order_release);
+                playback_loop.join();
+            }
+            const auto wall_duration =
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+            if (playback_exception) {
+                std::rethrow_exception(playback_exception);
+            }
+            if (teensy_exception) {
+                std::rethrow_exception(teensy_exception);
+            }
+            const auto teensy_duration = last_t > first_t ? last_t - first_t : 0;
+            statistics << events << " events and " << frames << " DMD frames in " << teensy_duration / 1e6
+                       << " s of Teensy time (decoded in " << wall_duration / 1e6 << " s)";
+            if (playback) {
+                statistics << ", " << emulated_teensy->written_bytes() << " bytes";
+            }
+            statistics << std::endl;
+            if (frames > 0) {
+                statistics << static_cast<double>(events) / frames << " events per frame";
+                if (playback) {
+                    statistics << ", " << static_cast<double>(emulated_teensy->written_bytes()) / frames
+                               << " bytes per frame";
+                }
+                statistics << std::endl;
+            }
+            for (std::size_t type = 0; type < type_to_count.size(); ++type) {
+                if (type_to_count[type] > 0) {
+                    statistics << "    '" << static_cast<char>(type) << "': " << type_to_count[type] << " events"
+                               << std::endl;
+                }
+            }
+        });
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// ring_buffer is a fixed-capacity double-ended buffer for a single thread.
+    /// Elements are appended at the back and removed from the front without moving the others.
+    template <typename Element>
+    class ring_buffer {
+        public:
+        ring_buffer(std::size_t capacity) : _elements(capacity), _begin(0), _size(0), _high_water_mark(0) {
+            if (capacity == 0) {
+                throw std::logic_error("the ring buffer capacity must be larger than zero");
+            }
+        }
+        ring_buffer(const ring_buffer&) = delete;
+        ring_buffer(ring_buffer&&) = default;
+        ring_buffer& operator=(const ring_buffer&) = delete;
+        ring_buffer& operator=(ring_buffer&&) = default;
+        virtual ~ring_buffer() {}
+
+        /// push_back appends an element, and returns false if the buffer is full.
+        bool push_back(const Element& element) {
+            if (_size == _elements.size()) {
+                return false;
+            }
+            _elements[(_begin + _size) % _elements.size()] = element;
+            ++_size;
+            if (_size > _high_water_mark) {
+                _high_water_mark = _size;
+            }
+            return true;
+        }
+
+        /// pop_front removes the given number of elements from the front.
+        void pop_front(std::size_t count = 1) {
+            if (count > _size) {
+                throw std::logic_error("not enough elements in the ring buffer");
+            }
+            _begin = (_begin + count) % _elements.size();
+            _size -= count;
+        }
+
+        /// operator[] returns the element at the given distance from the front.
+        Element& operator[](std::size_t index) {
+            return _elements[(_begin + index) % _elements.size()];
+        }
+
+        /// operator[] returns the element at the given distance from the front.
+        const Element& operator[](std::size_t index) const {
+            return _elements[(_begin + index) % _elements.size()];
+        }
+
+        /// front returns the oldest element.
+        Element& front() {
+            return _elements[_begin];
+        }
+
+        /// size returns the number of elements.
+        std::size_t size() const {
+            return _size;
+        }
+
+        /// empty returns true if the buffer contains no elements.
+        bool empty() const {
+            return _size == 0;
+        }
+
+        /// full returns true if the buffer cannot accept more elements.
+        bool full() const {
+            return _size == _elements.size();
+        }
+
+        /// capacity returns the maximum number of elements.
+        std::size_t capacity() const {
+            return _elements.size();
+        }
+
+        /// high_water_mark returns the largest number of elements simultaneously stored in the buffer.
+        std::size_t high_water_mark() const {
+            return _high_water_mark;
+        }
+
+        protected:
+        std::vector<Element> _elements;
+        std::size_t _begin;
+        std::size_t _size;
+        std::size_t _high_water_mark;
+    };
+}
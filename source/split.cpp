@@ -99,12 +99,16 @@ int main(int argc, char* argv[]) {
                         case 'l':
                         case 'r':
                         case 'w':
+                        case 'F':
+                        case 'S':
+                        case 'B':
                             if (write) {
                                 generic_event.t -= begin_t;
                                 (*write)(generic_event);
                             }
                             break;
                         case 'f':
+                        case 'g':
                             break;
                         default:
                             throw std::runtime_error("unexpected event type");
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// spsc_queue is a bounded lock-free queue for a single producer thread and a single consumer thread.
+    /// push fails instead of blocking when the queue is full, and failures are counted.
+    template <typename Element>
+    class spsc_queue {
+        public:
+        spsc_queue(std::size_t capacity) :
+            _elements(capacity + 1),
+            _head(0),
+            _tail(0),
+            _overflows(0),
+            _high_water_mark(0) {}
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue(spsc_queue&&) = default;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+        spsc_queue& operator=(spsc_queue&&) = default;
+        virtual ~spsc_queue() {}
+
+        /// push inserts an element, and returns false if the queue is full.
+        /// It must only be called by the producer thread.
+        bool push(const Element& element) {
+            const auto head = _head.load(std::memory_order_relaxed);
+            const auto next_head = (head + 1) % _elements.size();
+            const auto tail = _tail.load(std::memory_order_acquire);
+            if (next_head == tail) {
+                _overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            _elements[head] = element;
+            _head.store(next_head, std::memory_order_release);
+            const auto size = (next_head + _elements.size() - tail) % _elements.size();
+            if (size > _high_water_mark.load(std::memory_order_relaxed)) {
+                _high_water_mark.store(size, std::memory_order_relaxed);
+            }
+            return true;
+        }
+
+        /// pull retrieves the oldest element, and returns false if the queue is empty.
+        /// It must only be called by the consumer thread.
+        bool pull(Element& element) {
+            const auto tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            element = _elements[tail];
+            _tail.store((tail + 1) % _elements.size(), std::memory_order_release);
+            return true;
+        }
+
+        /// capacity returns the maximum number of elements in the queue.
+        std::size_t capacity() const {
+            return _elements.size() - 1;
+        }
+
+        /// overflows returns the number of rejected elements.
+        std::size_t overflows() const {
+            return _overflows.load(std::memory_order_relaxed);
+        }
+
+        /// high_water_mark returns the largest number of elements simultaneously stored in the queue.
+        std::size_t high_water_mark() const {
+            return _high_water_mark.load(std::memory_order_relaxed);
+        }
+
+        protected:
+        std::vector<Element> _elements;
+        std::atomic<std::size_t> _head;
+        std::atomic<std::size_t> _tail;
+        std::atomic<std::size_t> _overflows;
+        std::atomic<std::size_t> _high_water_mark;
+    };
+}
@@ -1,10 +1,24 @@
 #pragma once
 
+#include "latency_histogram.hpp"
+#include "line_fit.hpp"
+#include "reactor.hpp"
+#include "ring_buffer.hpp"
+#include "spsc_queue.hpp"
 #include <algorithm>
 #include <array>
 #include <atomic>
-#include <deque>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <dirent.h>
 #include <fcntl.h>
+#include <limits>
+#include <mutex>
+#include <poll.h>
+#include <queue>
+#include <stdexcept>
 #include <string>
 #include <sys/select.h>
 #include <sys/socket.h>
@@ -17,18 +31,148 @@
 /// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
 namespace hibiscus {
     /// teensy_event represents an event timestamped by the Teensy board.
+    /// device is the index of the board in a teensy_group, and 0 for a single board.
+    /// Periodic sync edges ('s' events) carry their index, starting at 1 for the first (rising) edge.
+    /// Compact DMD frames ('g' events) carry the id of their teensy_frame, which holds the subframes' timing.
     struct teensy_event {
         uint64_t t;
         uint8_t type;
+        uint8_t device;
+        uint32_t id;
+    };
+
+    /// teensy_frame holds the payload of a compact DMD frame: the intervals between consecutive subframes,
+    /// encoded as deviations from the nominal subframe period.
+    /// It is passed separately from the frame's 'g' event, so that teensy_event remains small.
+    struct teensy_frame {
+        /// deviations_capacity is the maximum number of subframes following the first one in a compact frame.
+        static constexpr std::size_t deviations_capacity = 32;
+
+        uint32_t id;
+        uint16_t period;
+        uint8_t deviations_size;
+        std::array<int8_t, deviations_capacity> deviations;
+
+        /// subframes returns the number of subframes in the frame, including the first one.
+        std::size_t subframes() const {
+            return static_cast<std::size_t>(deviations_size) + 1;
+        }
+
+        /// subframe_t returns the timestamp of the subframe with the given index, given the frame's timestamp t.
+        uint64_t subframe_t(uint64_t t, std::size_t index) const {
+            auto subframe_t = t;
+            for (std::size_t deviation_index = 0; deviation_index < index; ++deviation_index) {
+                subframe_t += static_cast<int64_t>(period) + deviations[deviation_index];
+            }
+            return subframe_t;
+        }
+    };
+
+    /// teensy_frames passes the compact DMD frames of a board from its delegate to the thread handling its events.
+    /// The delegate pushes a frame before the matching 'g' event, and the handler retrieves it with the event's id.
+    /// Frames are retrieved in order, hence the frames of events dropped on the way are skipped.
+    class teensy_frames {
+        public:
+        teensy_frames(std::size_t capacity) : _frames(capacity), _pending(), _has_pending(false) {}
+        teensy_frames(const teensy_frames&) = delete;
+        teensy_frames(teensy_frames&&) = delete;
+        teensy_frames& operator=(const teensy_frames&) = delete;
+        teensy_frames& operator=(teensy_frames&&) = delete;
+        virtual ~teensy_frames() {}
+
+        /// push inserts a frame, and returns false if the queue is full.
+        /// It must only be called by the board's delegate.
+        bool push(const teensy_frame& frame) {
+            return _frames.push(frame);
+        }
+
+        /// pull retrieves the frame with the given id, and returns false if it was dropped.
+        /// It must only be called by the thread handling the 'g' events, in order.
+        bool pull(uint32_t id, teensy_frame& frame) {
+            for (;;) {
+                if (!_has_pending) {
+                    if (!_frames.pull(_pending)) {
+                        return false;
+                    }
+                    _has_pending = true;
+                }
+                const auto difference = static_cast<int32_t>(_pending.id - id);
+                if (difference > 0) {
+                    return false;
+                }
+                _has_pending = false;
+                if (difference == 0) {
+                    frame = _pending;
+                    return true;
+                }
+            }
+        }
+
+        /// overflows returns the number of frames dropped because the queue was full.
+        std::size_t overflows() const {
+            return _frames.overflows();
+        }
+
+        protected:
+        spsc_queue<teensy_frame> _frames;
+        teensy_frame _pending;
+        bool _has_pending;
+    };
+
+    /// teensy_dmd_mode lists the DMD protocols supported by the record firmware.
+    enum class teensy_dmd_mode {
+        /// subframes: the Teensy sends one 'd' or 'e' message per DMD subframe.
+        subframes,
+        /// expanded_frames: the Teensy sends one 'g' message per frame, expanded into 'd' and 'e' events on the host.
+        expanded_frames,
+        /// compact_frames: the Teensy sends one 'g' message per frame, forwarded as a single 'g' event.
+        compact_frames,
+    };
+
+    /// teensy_message represents an unescaped message exchanged with the Teensy board.
+    /// The bytes are stored inline, hence messages can be passed around without heap allocations.
+    struct teensy_message {
+        /// capacity is the maximum number of bytes in a message, large enough for compact DMD frames
+        /// with extended timestamps.
+        static constexpr std::size_t capacity = 11 + teensy_frame::deviations_capacity;
+
+        std::array<uint8_t, capacity> bytes;
+        uint8_t size;
+
+        /// type returns the message's first byte.
+        uint8_t type() const {
+            return bytes[0];
+        }
+
+        /// teensy_t interprets the four bytes following the type as a little-endian timestamp.
+        uint32_t teensy_t() const {
+            return static_cast<uint32_t>(bytes[1]) | (static_cast<uint32_t>(bytes[2]) << 8)
+                   | (static_cast<uint32_t>(bytes[3]) << 16) | (static_cast<uint32_t>(bytes[4]) << 24);
+        }
+
+        /// extended_teensy_t interprets the eight bytes following the type as a little-endian timestamp.
+        uint64_t extended_teensy_t() const {
+            return static_cast<uint64_t>(teensy_t())
+                   | (static_cast<uint64_t>(
+                          static_cast<uint32_t>(bytes[5]) | (static_cast<uint32_t>(bytes[6]) << 8)
+                          | (static_cast<uint32_t>(bytes[7]) << 16) | (static_cast<uint32_t>(bytes[8]) << 24))
+                      << 32);
+        }
     };
 
     /// tty represents a generic serial connection.
     /// timeout is a number of 0.1 s intervals.
+    /// Incoming bytes are loaded by blocks into an internal buffer, so that a single system call serves every byte
+    /// available on the line.
     class tty {
         public:
         tty(const std::string& filename, uint64_t baudrate, uint64_t timeout) :
             _filename(filename),
-            _fileDescriptor(open(_filename.c_str(), O_RDWR | O_NOCTTY)) {
+            _fileDescriptor(open(_filename.c_str(), O_RDWR | O_NOCTTY)),
+            _timeout(timeout),
+            _buffer(1 << 12),
+            _begin(0),
+            _end(0) {
             if (_fileDescriptor < 0) {
                 throw std::runtime_error(std::string("opening '") + _filename + "' failed");
             }
@@ -54,8 +198,8 @@ namespace hibiscus {
         virtual ~tty() {}
 
         /// write sends data to the tty.
-        virtual void write(const std::vector<uint8_t>& bytes) {
-            if (::write(_fileDescriptor, bytes.data(), bytes.size()) != bytes.size()) {
+        virtual void write(const uint8_t* bytes, std::size_t size) {
+            if (::write(_fileDescriptor, bytes, size) != static_cast<ssize_t>(size)) {
                 throw std::runtime_error("write error");
             }
             tcdrain(_fileDescriptor);
@@ -63,156 +207,504 @@ namespace hibiscus {
 
         /// read loads a single byte from the tty.
         uint8_t read() {
-            volatile uint8_t byte;
-            const auto bytes_read = ::read(_fileDescriptor, const_cast<uint8_t*>(&byte), 1);
-            if (bytes_read <= 0) {
-                if (access(_filename.c_str(), F_OK) < 0) {
-                    throw std::logic_error(std::string("'") + _filename + "' disconnected");
-                }
+            if (_begin == _end && !fill()) {
                 throw std::runtime_error("read timeout");
             }
+            const auto byte = _buffer[_begin];
+            ++_begin;
             return byte;
         }
 
+        /// read_block loads every available byte from the tty.
+        /// The returned range is empty if no bytes were received before the timeout.
+        /// It remains valid until the next call to read or read_block.
+        std::pair<const uint8_t*, const uint8_t*> read_block() {
+            if (_begin == _end) {
+                fill();
+            }
+            const auto begin = _buffer.data() + _begin;
+            const auto end = _buffer.data() + _end;
+            _begin = _end;
+            return {begin, end};
+        }
+
+        /// file_descriptor returns the tty's file descriptor, so that it can be monitored by a reactor.
+        int32_t file_descriptor() const {
+            return _fileDescriptor;
+        }
+
         protected:
+        /// fill waits for the tty to become readable and loads as many bytes as possible into the buffer.
+        /// false is returned if the timeout expired.
+        bool fill() {
+            pollfd poll_file_descriptor;
+            poll_file_descriptor.fd = _fileDescriptor;
+            poll_file_descriptor.events = POLLIN;
+            const auto poll_result = poll(&poll_file_descriptor, 1, static_cast<int>(_timeout * 100));
+            if (poll_result == 0 || (poll_result < 0 && errno == EINTR)) {
+                return false;
+            }
+            ssize_t bytes_read = -1;
+            if (poll_result > 0 && (poll_file_descriptor.revents & POLLIN)) {
+                bytes_read = ::read(_fileDescriptor, _buffer.data(), _buffer.size());
+            }
+            if (bytes_read <= 0) {
+                if (access(_filename.c_str(), F_OK) < 0 || (poll_file_descriptor.revents & (POLLHUP | POLLERR))) {
+                    throw std::logic_error(std::string("'") + _filename + "' disconnected");
+                }
+                return false;
+            }
+            _begin = 0;
+            _end = static_cast<std::size_t>(bytes_read);
+            return true;
+        }
+
         const std::string _filename;
         int32_t _fileDescriptor;
+        const uint64_t _timeout;
+        std::vector<uint8_t> _buffer;
+        std::size_t _begin;
+        std::size_t _end;
+    };
+
+    /// teensy_clock maps the Teensy clock to the host's steady clock with an affine model.
+    /// The model is fitted online from pairs of timestamps (Teensy flush message, host reception).
+    /// Each sample triggers a least-squares fit over a sliding window, followed by a second fit which ignores
+    /// the samples whose residual exceeds three scaled median absolute deviations (delayed USB transfers).
+    /// Conversions are thread-safe and run in constant time.
+    class teensy_clock {
+        public:
+        teensy_clock(std::size_t window) : _fit(window, 1.0), _drift(0), _jitter(0) {
+            _model = {false, 0, 0, 1};
+            _accessing_model.clear(std::memory_order_release);
+        }
+        teensy_clock(const teensy_clock&) = delete;
+        teensy_clock(teensy_clock&&) = delete;
+        teensy_clock& operator=(const teensy_clock&) = delete;
+        teensy_clock& operator=(teensy_clock&&) = delete;
+        virtual ~teensy_clock() {}
+
+        /// add updates the model with a Teensy timestamp and the matching host time.
+        /// It must be called by a single thread.
+        virtual void add(uint64_t teensy_t, std::chrono::steady_clock::time_point host_t) {
+            _fit.add(
+                static_cast<double>(teensy_t),
+                static_cast<double>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(host_t.time_since_epoch()).count()));
+            const auto new_model = _fit.model();
+            if (!new_model.ready) {
+                return;
+            }
+            while (_accessing_model.test_and_set(std::memory_order_acquire)) {
+            }
+            _model = new_model;
+            _accessing_model.clear(std::memory_order_release);
+            _drift.store((new_model.slope - 1) * 1e6, std::memory_order_release);
+            _jitter.store(_fit.jitter(), std::memory_order_release);
+        }
+
+        /// ready returns true once the model can convert timestamps.
+        bool ready() const {
+            return load_model().ready;
+        }
+
+        /// host_to_teensy converts a host time to a Teensy timestamp.
+        uint64_t host_to_teensy(std::chrono::steady_clock::time_point host_t) const {
+            const auto teensy_t = load_model().x(static_cast<double>(
+                std::chrono::duration_cast<std::chrono::microseconds>(host_t.time_since_epoch()).count()));
+            return teensy_t < 0 ? 0 : static_cast<uint64_t>(std::llround(teensy_t));
+        }
+
+        /// teensy_to_host converts a Teensy timestamp to a host time.
+        std::chrono::steady_clock::time_point teensy_to_host(uint64_t teensy_t) const {
+            const auto host_t = std::chrono::microseconds(std::llround(load_model().y(static_cast<double>(teensy_t))));
+            return std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(host_t));
+        }
+
+        /// drift returns the Teensy clock drift relative to the host clock, in parts per million.
+        double drift() const {
+            return _drift.load(std::memory_order_acquire);
+        }
+
+        /// jitter returns the root mean square of the inliers' residuals, in microseconds.
+        double jitter() const {
+            return _jitter.load(std::memory_order_acquire);
+        }
+
+        protected:
+        /// load_model returns a copy of the current model, which maps Teensy timestamps to host timestamps.
+        line load_model() const {
+            while (_accessing_model.test_and_set(std::memory_order_acquire)) {
+            }
+            const auto current_model = _model;
+            _accessing_model.clear(std::memory_order_release);
+            return current_model;
+        }
+
+        sliding_line_fit _fit;
+        line _model;
+        mutable std::atomic_flag _accessing_model;
+        std::atomic<double> _drift;
+        std::atomic<double> _jitter;
+    };
+
+    /// teensy_command represents a message sent by the host to the Teensy board.
+    /// If has_value is true, the type is followed by value (uint32, little endian).
+    /// The timestamps are measured with the host's steady clock.
+    struct teensy_command {
+        uint8_t type;
+        std::chrono::steady_clock::time_point enqueue_t;
+        std::chrono::steady_clock::time_point write_t;
+        bool has_value;
+        uint32_t value;
     };
 
     /// teensy manages the communication with the Teensy.
+    /// Messages are queued by send and written to the tty by a dedicated thread,
+    /// so that callers are never blocked by the serial communication.
+    /// The queues have a fixed capacity, so that sending does not allocate memory.
     class teensy {
         public:
-        teensy() : _tty("/dev/ttyACM0", B9600, 1) {}
+        /// command_capacity is the maximum number of messages waiting to be written or to be echoed.
+        static constexpr std::size_t command_capacity = 1 << 10;
+
+        teensy(const std::string& filename) :
+            _tty(filename, B9600, 1),
+            _commands(command_capacity),
+            _written_commands(command_capacity),
+            _writing(true),
+            _dropped_commands(0) {}
         teensy(const teensy&) = delete;
         teensy(teensy&&) = default;
         teensy& operator=(const teensy&) = delete;
         teensy& operator=(teensy&&) = default;
         virtual ~teensy() {}
 
-        /// send sends a message to the teensy.
-        virtual void send(uint8_t type) {
-            write({type});
+        /// send queues a message for the Teensy, and returns immediately.
+        /// false is returned (and the message dropped) if the queue is full.
+        virtual bool send(uint8_t type) {
+            return enqueue(type, false, 0);
+        }
+
+        /// send_value queues a message with a 32-bit payload for the Teensy, and returns immediately.
+        /// false is returned (and the message dropped) if the queue is full.
+        virtual bool send_value(uint8_t type, uint32_t value) {
+            return enqueue(type, true, value);
+        }
+
+        /// acknowledge matches an echo received from the Teensy with the oldest written command of the same type,
+        /// and counts the round-trip duration.
+        /// false is returned if no command matches.
+        virtual bool acknowledge(uint8_t type) {
+            const auto echo_t = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(_commands_mutex);
+            std::size_t command_index = 0;
+            while (command_index < _written_commands.size() && _written_commands[command_index].type != type) {
+                ++command_index;
+            }
+            if (command_index == _written_commands.size()) {
+                return false;
+            }
+            _round_trip_histogram.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                echo_t - _written_commands[command_index].enqueue_t));
+            // the older commands move one step back (echoes usually match the oldest command)
+            for (; command_index > 0; --command_index) {
+                _written_commands[command_index] = _written_commands[command_index - 1];
+            }
+            _written_commands.pop_front();
+            return true;
+        }
+
+        /// round_trip_histogram returns the durations between send calls and the matching echoes.
+        const latency_histogram& round_trip_histogram() const {
+            return _round_trip_histogram;
+        }
+
+        /// dropped_commands returns the number of messages dropped because the queue was full.
+        uint64_t dropped_commands() const {
+            return _dropped_commands.load(std::memory_order_relaxed);
         }
 
         protected:
+        /// enqueue appends a message to the queue, and wakes the writing thread.
+        bool enqueue(uint8_t type, bool has_value, uint32_t value) {
+            {
+                std::lock_guard<std::mutex> lock(_commands_mutex);
+                teensy_command command;
+                command.type = type;
+                command.enqueue_t = std::chrono::steady_clock::now();
+                command.has_value = has_value;
+                command.value = value;
+                if (!_commands.push_back(command)) {
+                    _dropped_commands.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            _commands_condition.notify_one();
+            return true;
+        }
+
+        /// write_commands writes the queued messages until stop_writing is called and the queue is empty.
+        /// Written messages are kept for a second, so that they can be matched with their echoes.
+        void write_commands() {
+            std::unique_lock<std::mutex> lock(_commands_mutex);
+            for (;;) {
+                _commands_condition.wait(lock, [this]() { return !_commands.empty() || !_writing; });
+                if (_commands.empty()) {
+                    break;
+                }
+                auto command = _commands.front();
+                _commands.pop_front();
+                lock.unlock();
+                teensy_message message;
+                message.bytes[0] = command.type;
+                message.size = 1;
+                if (command.has_value) {
+                    for (std::size_t index = 0; index < 4; ++index) {
+                        message.bytes[1 + index] = static_cast<uint8_t>((command.value >> (8 * index)) & 0xff);
+                    }
+                    message.size = 5;
+                }
+                write(message);
+                command.write_t = std::chrono::steady_clock::now();
+                lock.lock();
+                // commands which are never echoed expire after a second, or when the queue is full
+                while (!_written_commands.empty()
+                       && (_written_commands.full()
+                           || command.write_t - _written_commands.front().write_t > std::chrono::seconds(1))) {
+                    _written_commands.pop_front();
+                }
+                _written_commands.push_back(command);
+            }
+        }
+
+        /// stop_writing makes write_commands return once the queue is empty.
+        void stop_writing() {
+            {
+                std::lock_guard<std::mutex> lock(_commands_mutex);
+                _writing = false;
+            }
+            _commands_condition.notify_one();
+        }
+
         /// write encodes a sends a message to the Teensy board.
-        virtual void write(const std::vector<uint8_t>& message) {
-            std::vector<uint8_t> encoded_message{0x00};
-            for (auto byte : message) {
-                switch (byte) {
+        /// It must only be called by the writing thread.
+        virtual void write(const teensy_message& message) {
+            std::size_t size = 0;
+            _encoded_message[size] = 0x00;
+            ++size;
+            for (std::size_t index = 0; index < message.size; ++index) {
+                switch (message.bytes[index]) {
                     case 0x00:
-                        encoded_message.push_back(0xaa);
-                        encoded_message.push_back(0xab);
+                        _encoded_message[size] = 0xaa;
+                        _encoded_message[size + 1] = 0xab;
+                        size += 2;
                         break;
                     case 0xaa:
-                        encoded_message.push_back(0xaa);
-                        encoded_message.push_back(0xac);
+                        _encoded_message[size] = 0xaa;
+                        _encoded_message[size + 1] = 0xac;
+                        size += 2;
                         break;
                     case 0xff:
-                        encoded_message.push_back(0xaa);
-                        encoded_message.push_back(0xad);
+                        _encoded_message[size] = 0xaa;
+                        _encoded_message[size + 1] = 0xad;
+                        size += 2;
                         break;
                     default:
-                        encoded_message.push_back(byte);
+                        _encoded_message[size] = message.bytes[index];
+                        ++size;
                 }
             }
-            encoded_message.push_back(0xff);
-            _tty.write(encoded_message);
+            _encoded_message[size] = 0xff;
+            ++size;
+            _tty.write(_encoded_message.data(), size);
         }
 
         tty _tty;
+        std::mutex _commands_mutex;
+        std::condition_variable _commands_condition;
+        ring_buffer<teensy_command> _commands;
+        ring_buffer<teensy_command> _written_commands;
+        bool _writing;
+        std::atomic<uint64_t> _dropped_commands;
+        latency_histogram _round_trip_histogram;
+        std::array<uint8_t, teensy_message::capacity * 2 + 2> _encoded_message;
     };
 
     /// specialized_teensy implements the communication with a Teensy board.
+    /// Incoming bytes are read by a dedicated thread, or by the given reactor's thread if event_loop is not null.
+    /// Outgoing messages are written by a second dedicated thread.
     template <typename Delegate, typename HandleException>
     class specialized_teensy : public teensy {
         public:
-        specialized_teensy(Delegate delegate, HandleException handle_exception) :
+        specialized_teensy(
+            const std::string& filename,
+            Delegate delegate,
+            HandleException handle_exception,
+            reactor* event_loop = nullptr) :
+            teensy(filename),
             _delegate(std::forward<Delegate>(delegate)),
             _handle_exception(std::forward<HandleException>(handle_exception)),
-            _running(true) {
-            _delegate.handle_start(this, _tty);
-            _read_loop = std::thread([this]() {
+            _event_loop(event_loop),
+            _running(true),
+            _reading(false),
+            _escaped(false) {
+            _message.size = 0;
+            _write_loop = std::thread([this]() {
                 try {
-                    std::vector<uint8_t> message;
-                    bool reading = false;
-                    bool escaped = false;
-                    while (_running.load(std::memory_order_acquire)) {
-                        uint8_t byte;
-                        try {
-                            byte = _tty.read();
-                        } catch (const std::runtime_error&) {
-                            continue;
-                        }
-                        if (reading) {
-                            if (escaped) {
-                                escaped = false;
-                                switch (byte) {
-                                    case 0xab:
-                                        message.push_back(0x00);
-                                        break;
-                                    case 0xac:
-                                        message.push_back(0xaa);
-                                        break;
-                                    case 0xad:
-                                        message.push_back(0xff);
-                                        break;
-                                    default:
-                                        reading = false;
-                                }
-                            } else {
-                                switch (byte) {
-                                    case 0x00:
-                                        message.clear();
-                                        break;
-                                    case 0xaa:
-                                        escaped = true;
-                                        break;
-                                    case 0xff:
-                                        reading = false;
-                                        _delegate.handle_message(this, message);
-                                        break;
-                                    default:
-                                        message.push_back(byte);
-                                        break;
-                                }
-                            }
-                        } else if (byte == 0x00) {
-                            reading = true;
-                            escaped = false;
-                            message.clear();
-                        }
-                    }
-                    _delegate.handle_stop(this, _tty);
+                    write_commands();
                 } catch (...) {
                     this->_handle_exception(std::current_exception());
                 }
             });
+            try {
+                _delegate.handle_start(this, _tty);
+            } catch (...) {
+                stop_writing();
+                _write_loop.join();
+                throw;
+            }
+            if (_event_loop) {
+                const auto file_descriptor = _tty.file_descriptor();
+                _event_loop->add(file_descriptor, [this, file_descriptor]() {
+                    try {
+                        const auto bytes = _tty.read_block();
+                        decode(bytes.first, bytes.second);
+                    } catch (...) {
+                        _event_loop->remove(file_descriptor);
+                        this->_handle_exception(std::current_exception());
+                    }
+                });
+            } else {
+                _read_loop = std::thread([this]() {
+                    try {
+                        while (_running.load(std::memory_order_acquire)) {
+                            const auto bytes = _tty.read_block();
+                            decode(bytes.first, bytes.second);
+                        }
+                        _delegate.handle_stop(this, _tty);
+                    } catch (...) {
+                        this->_handle_exception(std::current_exception());
+                    }
+                });
+            }
         }
         specialized_teensy(const specialized_teensy&) = delete;
         specialized_teensy(specialized_teensy&&) = default;
         specialized_teensy& operator=(const specialized_teensy&) = delete;
         specialized_teensy& operator=(specialized_teensy&&) = default;
         virtual ~specialized_teensy() {
-            _running.store(false, std::memory_order_release);
-            _read_loop.join();
+            if (_event_loop) {
+                _event_loop->remove(_tty.file_descriptor());
+                try {
+                    _delegate.handle_stop(this, _tty);
+                } catch (...) {
+                    _handle_exception(std::current_exception());
+                }
+            } else {
+                _running.store(false, std::memory_order_release);
+                _read_loop.join();
+            }
+            stop_writing();
+            _write_loop.join();
         }
 
         protected:
+        /// decode unescapes a block of bytes and dispatches the complete messages to the delegate.
+        /// The decoder state is preserved between calls, hence messages may span several blocks.
+        void decode(const uint8_t* begin, const uint8_t* end) {
+            for (; begin != end; ++begin) {
+                const auto byte = *begin;
+                if (_reading) {
+                    if (_escaped) {
+                        _escaped = false;
+                        switch (byte) {
+                            case 0xab:
+                                push(0x00);
+                                break;
+                            case 0xac:
+                                push(0xaa);
+                                break;
+                            case 0xad:
+                                push(0xff);
+                                break;
+                            default:
+                                _reading = false;
+                        }
+                    } else {
+                        switch (byte) {
+                            case 0x00:
+                                _message.size = 0;
+                                break;
+                            case 0xaa:
+                                _escaped = true;
+                                break;
+                            case 0xff:
+                                _reading = false;
+                                _delegate.handle_message(this, _message);
+                                break;
+                            default:
+                                push(byte);
+                                break;
+                        }
+                    }
+                } else if (byte == 0x00) {
+                    _reading = true;
+                    _escaped = false;
+                    _message.size = 0;
+                }
+            }
+        }
+
+        /// push appends an unescaped byte to the current message.
+        /// Messages longer than the capacity are discarded.
+        void push(uint8_t byte) {
+            if (_message.size < _message.bytes.size()) {
+                _message.bytes[_message.size] = byte;
+                ++_message.size;
+            } else {
+                _reading = false;
+            }
+        }
+
         Delegate _delegate;
         HandleException _handle_exception;
+        reactor* _event_loop;
         std::atomic_bool _running;
         std::thread _read_loop;
+        std::thread _write_loop;
+        teensy_message _message;
+        bool _reading;
+        bool _escaped;
     };
 
     /// teensy_record_delegate is a delegate for the record firmware.
+    /// If clock is not null, it is updated with every flush message.
+    /// If frames is not null, it receives the payloads of the compact DMD frames.
     template <typename HandleEvent>
     class teensy_record_delegate {
         public:
-        teensy_record_delegate(HandleEvent handle_event) :
+        /// buffer_capacity is the number of events between two flushes stored without allocating memory.
+        static constexpr std::size_t buffer_capacity = 1 << 10;
+
+        teensy_record_delegate(
+            HandleEvent handle_event,
+            teensy_dmd_mode dmd_mode,
+            teensy_clock* clock,
+            teensy_frames* frames = nullptr) :
             _handle_event(std::forward<HandleEvent>(handle_event)),
+            _dmd_mode(dmd_mode),
+            _clock(clock),
+            _frames(frames),
+            _extended_timestamps(false),
             _previous_teensy_t(0),
-            _t_correction(0) {}
+            _t_correction(0),
+            _dropped_frames(0),
+            _next_frame_id(0),
+            _buffered_events(later(), reserved_events()) {
+            _uncorrected_events.reserve(buffer_capacity);
+        }
         teensy_record_delegate(const teensy_record_delegate&) = delete;
         teensy_record_delegate(teensy_record_delegate&&) = default;
         teensy_record_delegate& operator=(const teensy_record_delegate&) = delete;
@@ -220,133 +712,284 @@ namespace hibiscus {
         virtual ~teensy_record_delegate() {}
         virtual void handle_start(teensy* parent, tty& parent_tty) {
             parent->send('r');
-            {
-                uint8_t state = 0;
-                auto ready = false;
-                while (!ready) {
-                    uint8_t byte;
-                    try {
-                        byte = parent_tty.read();
-                    } catch (const std::runtime_error&) {
-                        continue;
-                    }
-                    switch (state) {
-                        case 0:
-                            if (byte == 0x00) {
-                                state = 1;
-                            }
-                            break;
-                        case 1:
-                            if (byte == 'r') {
-                                state = 2;
-                            } else {
-                                state = 0;
-                            }
-                            break;
-                        case 2:
-                            if (byte == 0xff) {
-                                ready = true;
-                            } else {
-                                state = 0;
-                            }
-                            break;
-                        default:
-                            break;
-                    }
+            wait_for(parent_tty, 'r', std::chrono::steady_clock::duration::max());
+            parent->send('x');
+            std::vector<teensy_message> startup_messages;
+            _extended_timestamps =
+                wait_for_extended_timestamps(parent_tty, std::chrono::milliseconds(500), startup_messages);
+            // firmwares without extended timestamps keep sending 32-bit messages while the host waits for the reply
+            if (!_extended_timestamps) {
+                for (const auto& message : startup_messages) {
+                    handle_message(parent, message);
                 }
             }
+            if (_dmd_mode != teensy_dmd_mode::subframes) {
+                parent->send('p');
+            }
         }
-        virtual void handle_message(teensy*, const std::vector<uint8_t>& message) {
-            if (message.size() == 5) {
-                if (message[0] == 'f') {
-                    const auto t = teensy_t_to_t(message_to_teensy_t(message));
-                    for (auto& buffered_event : _buffered_events) {
-                        if (!buffered_event.corrected) {
-                            std::array<std::pair<uint64_t, uint64_t>, 3> differences_and_ts{
-                                difference_and_t(t, buffered_event.event.t + _t_correction),
-                                difference_and_t(
-                                    t,
-                                    buffered_event.event.t + _t_correction + std::numeric_limits<uint32_t>::max() + 1),
-                                _t_correction > 0 ?
-                                    difference_and_t(
-                                        t,
-                                        buffered_event.event.t + _t_correction
-                                            - (std::numeric_limits<uint32_t>::max() + 1)) :
-                                    std::pair<uint64_t, uint64_t>{std::numeric_limits<uint64_t>::max(), 0},
-                            };
-                            std::sort(differences_and_ts.begin(), differences_and_ts.end());
-                            buffered_event.event.t = std::get<0>(differences_and_ts).second;
-                            buffered_event.corrected = true;
+        virtual void handle_message(teensy* parent, const teensy_message& message) {
+            const std::size_t timestamp_size = _extended_timestamps ? 8 : 4;
+            if (message.type() == 'g') {
+                const std::size_t header_size = 3 + timestamp_size;
+                // corrupted frames, or frames with more deviations than teensy_frame can store, are dropped
+                if (message.size < header_size
+                    || message.size - header_size > teensy_frame::deviations_capacity) {
+                    ++_dropped_frames;
+                    return;
+                }
+                const auto frame_t = _extended_timestamps ? message.extended_teensy_t() : message.teensy_t();
+                teensy_frame frame;
+                frame.id = _next_frame_id;
+                ++_next_frame_id;
+                frame.deviations_size = static_cast<uint8_t>(message.size - header_size);
+                frame.period = static_cast<uint16_t>(
+                    message.bytes[header_size - 2] | (message.bytes[header_size - 1] << 8));
+                for (uint8_t index = 0; index < frame.deviations_size; ++index) {
+                    // deviations are offset by 128, so that null deviations are not escaped
+                    frame.deviations[index] =
+                        static_cast<int8_t>(static_cast<int32_t>(message.bytes[header_size + index]) - 128);
+                }
+                if (_dmd_mode == teensy_dmd_mode::compact_frames) {
+                    if (_frames) {
+                        _frames->push(frame);
+                    }
+                    buffer({frame_t, 'g', 0, frame.id});
+                } else {
+                    for (std::size_t index = 0; index < frame.subframes(); ++index) {
+                        buffer({frame.subframe_t(frame_t, index), static_cast<uint8_t>(index == 0 ? 'd' : 'e')});
+                    }
+                }
+            } else if (message.type() == 'c') {
+                if (message.size == 5) {
+                    _handle_event(teensy_event{message.teensy_t(), message.type()});
+                }
+            } else if (message.type() == 's') {
+                if (message.size == 5 + timestamp_size) {
+                    teensy_event edge_event{
+                        _extended_timestamps ? message.extended_teensy_t() : teensy_t_to_t(message.teensy_t()), 's'};
+                    for (std::size_t index = 0; index < 4; ++index) {
+                        edge_event.id |= static_cast<uint32_t>(message.bytes[1 + timestamp_size + index])
+                                         << (8 * index);
+                    }
+                    _handle_event(edge_event);
+                }
+            } else if (message.size == 1 + timestamp_size) {
+                if (message.type() == 'f') {
+                    uint64_t t;
+                    if (_extended_timestamps) {
+                        t = message.extended_teensy_t();
+                    } else {
+                        t = teensy_t_to_t(message.teensy_t());
+                        for (auto buffered_event : _uncorrected_events) {
+                            buffered_event.t = correct(buffered_event.t, t);
+                            _buffered_events.push(buffered_event);
                         }
+                        _uncorrected_events.clear();
                     }
-                    std::sort(
-                        _buffered_events.begin(),
-                        _buffered_events.end(),
-                        [](buffered_event first, buffered_event second) { return first.event.t < second.event.t; });
-                    auto event_iterator = _buffered_events.begin();
-                    for (; event_iterator != _buffered_events.end() && event_iterator->event.t < t; ++event_iterator) {
-                        _handle_event(event_iterator->event);
+                    if (_clock) {
+                        _clock->add(t, std::chrono::steady_clock::now());
                     }
-                    _buffered_events.erase(_buffered_events.begin(), event_iterator);
-                } else if (message[0] == 'd' || message[0] == 'e' || message[0] == 'l' || message[0] == 'r') {
-                    _buffered_events.push_back({{message_to_teensy_t(message), message[0]}, false});
-                } else if (message[0] == 'c') {
-                    _handle_event(teensy_event{message_to_teensy_t(message), message[0]});
+                    while (!_buffered_events.empty() && _buffered_events.top().t < t) {
+                        _handle_event(_buffered_events.top());
+                        _buffered_events.pop();
+                    }
+                } else if (
+                    message.type() == 'd' || message.type() == 'e' || message.type() == 'l'
+                    || message.type() == 'r') {
+                    buffer({_extended_timestamps ? message.extended_teensy_t() : message.teensy_t(), message.type()});
                 } else {
-                    _handle_event(teensy_event{teensy_t_to_t(message_to_teensy_t(message)), message[0]});
+                    if (message.type() == 'a' || message.type() == 'b') {
+                        parent->acknowledge(message.type());
+                    }
+                    if (_extended_timestamps) {
+                        _handle_event(teensy_event{message.extended_teensy_t(), message.type()});
+                    } else {
+                        _handle_event(teensy_event{teensy_t_to_t(message.teensy_t()), message.type()});
+                    }
                 }
             }
         }
+
+        /// extended_timestamps returns true if the firmware sends 64-bit timestamps.
+        bool extended_timestamps() const {
+            return _extended_timestamps;
+        }
+
+        /// dropped_frames returns the number of compact DMD frames ('g' messages) dropped because
+        /// they were too short or carried more than teensy_frame::deviations_capacity deviations.
+        uint64_t dropped_frames() const {
+            return _dropped_frames;
+        }
+
         virtual void handle_stop(teensy*, tty&) {
             const auto t = static_cast<uint64_t>(_previous_teensy_t) + _t_correction;
-            for (auto& buffered_event : _buffered_events) {
-                if (!buffered_event.corrected) {
-                    std::array<std::pair<uint64_t, uint64_t>, 3> differences_and_ts{
-                        difference_and_t(t, buffered_event.event.t + _t_correction),
-                        difference_and_t(
-                            t, buffered_event.event.t + _t_correction + std::numeric_limits<uint32_t>::max() + 1),
-                        _t_correction > 0 ? difference_and_t(
-                            t, buffered_event.event.t + _t_correction - (std::numeric_limits<uint32_t>::max() + 1)) :
-                                            std::pair<uint64_t, uint64_t>{std::numeric_limits<uint64_t>::max(), 0},
-                    };
-                    std::sort(differences_and_ts.begin(), differences_and_ts.end());
-                    buffered_event.event.t = std::get<0>(differences_and_ts).second;
-                    buffered_event.corrected = true;
-                }
-            }
-            std::sort(
-                _buffered_events.begin(), _buffered_events.end(), [](buffered_event first, buffered_event second) {
-                    return first.event.t < second.event.t;
-                });
-            for (auto buffered_event : _buffered_events) {
-                _handle_event(buffered_event.event);
+            for (auto buffered_event : _uncorrected_events) {
+                buffered_event.t = correct(buffered_event.t, t);
+                _buffered_events.push(buffered_event);
+            }
+            _uncorrected_events.clear();
+            while (!_buffered_events.empty()) {
+                _handle_event(_buffered_events.top());
+                _buffered_events.pop();
             }
         }
 
         protected:
-        /// buffered_event is used as part of the timestamp correction process.
-        struct buffered_event {
-            teensy_event event;
-            bool corrected;
-        };
+        /// wait_for_extended_timestamps consumes messages until the firmware replies to the extended timestamps
+        /// request, and stores the other messages in startup_messages.
+        /// false is returned if the reply was not received before the given duration, and startup_messages then
+        /// contains every 32-bit message received in the meantime. Otherwise, the messages preceding the reply
+        /// are discarded: their 32-bit timestamps cannot be related to the extended ones.
+        static bool wait_for_extended_timestamps(
+            tty& parent_tty,
+            std::chrono::steady_clock::duration duration,
+            std::vector<teensy_message>& startup_messages) {
+            const auto deadline = std::chrono::steady_clock::now() + duration;
+            teensy_message message;
+            message.size = 0;
+            auto reading = false;
+            auto escaped = false;
+            auto push = [&](uint8_t byte) {
+                if (message.size < message.bytes.size()) {
+                    message.bytes[message.size] = byte;
+                    ++message.size;
+                } else {
+                    reading = false;
+                }
+            };
+            for (;;) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                uint8_t byte;
+                try {
+                    byte = parent_tty.read();
+                } catch (const std::runtime_error&) {
+                    continue;
+                }
+                if (reading) {
+                    if (escaped) {
+                        escaped = false;
+                        switch (byte) {
+                            case 0xab:
+                                push(0x00);
+                                break;
+                            case 0xac:
+                                push(0xaa);
+                                break;
+                            case 0xad:
+                                push(0xff);
+                                break;
+                            default:
+                                reading = false;
+                        }
+                    } else {
+                        switch (byte) {
+                            case 0x00:
+                                message.size = 0;
+                                break;
+                            case 0xaa:
+                                escaped = true;
+                                break;
+                            case 0xff:
+                                reading = false;
+                                if (message.size == 1 && message.type() == 'x') {
+                                    startup_messages.clear();
+                                    return true;
+                                }
+                                if (message.size > 0) {
+                                    startup_messages.push_back(message);
+                                }
+                                break;
+                            default:
+                                push(byte);
+                                break;
+                        }
+                    }
+                } else if (byte == 0x00) {
+                    reading = true;
+                    escaped = false;
+                    message.size = 0;
+                }
+            }
+        }
 
-        /// message_to_teensy_t interprets a message's bytes.
-        static uint32_t message_to_teensy_t(const std::vector<uint8_t>& message) {
-            return static_cast<uint32_t>(message[1]) | (static_cast<uint32_t>(message[2]) << 8)
-                   | (static_cast<uint32_t>(message[3]) << 16) | (static_cast<uint32_t>(message[4]) << 24);
+        /// wait_for consumes bytes until the firmware sends a message which only contains the given type.
+        /// false is returned if the message was not received before the given duration.
+        static bool wait_for(tty& parent_tty, uint8_t type, std::chrono::steady_clock::duration duration) {
+            const auto deadline = duration == std::chrono::steady_clock::duration::max() ?
+                                      std::chrono::steady_clock::time_point::max() :
+                                      std::chrono::steady_clock::now() + duration;
+            uint8_t state = 0;
+            for (;;) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                uint8_t byte;
+                try {
+                    byte = parent_tty.read();
+                } catch (const std::runtime_error&) {
+                    continue;
+                }
+                switch (state) {
+                    case 0:
+                        if (byte == 0x00) {
+                            state = 1;
+                        }
+                        break;
+                    case 1:
+                        if (byte == type) {
+                            state = 2;
+                        } else {
+                            state = 0;
+                        }
+                        break;
+                    case 2:
+                        if (byte == 0xff) {
+                            return true;
+                        }
+                        state = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
         }
 
-        /// absolute_difference returns the absolute distance between two unsigned integers.
-        static uint64_t absolute_difference(uint64_t first, uint64_t second) {
-            if (first > second) {
-                return first - second;
+        /// buffer stores an event until the next flush message.
+        /// Events with 32-bit timestamps are corrected when the flush message is received,
+        /// whereas events with extended timestamps are ordered immediately.
+        void buffer(const teensy_event& event) {
+            if (_extended_timestamps) {
+                _buffered_events.push(event);
+            } else {
+                _uncorrected_events.push_back(event);
             }
-            return second - first;
         }
 
-        /// difference_and_t wraps a candidate t and a distance in a pair.
-        static std::pair<uint64_t, uint64_t> difference_and_t(uint64_t t, uint64_t candidate_t) {
-            return {absolute_difference(t, candidate_t), candidate_t};
+        /// reserved_events returns an empty container with buffer_capacity preallocated events.
+        static std::vector<teensy_event> reserved_events() {
+            std::vector<teensy_event> events;
+            events.reserve(buffer_capacity);
+            return events;
+        }
+
+        /// later orders the buffered events so that the earliest one is at the top of the queue.
+        struct later {
+            bool operator()(const teensy_event& first, const teensy_event& second) const {
+                return first.t > second.t;
+            }
+        };
+
+        /// correct converts an uint32 timestamp to the uint64 timestamp closest to the reference t.
+        static uint64_t correct(uint64_t teensy_t, uint64_t t) {
+            const auto corrected_t = static_cast<int64_t>(t)
+                                     + static_cast<int32_t>(static_cast<uint32_t>(teensy_t) - static_cast<uint32_t>(t));
+            if (corrected_t < 0) {
+                return static_cast<uint64_t>(
+                    corrected_t + static_cast<int64_t>(std::numeric_limits<uint32_t>::max()) + 1);
+            }
+            return static_cast<uint64_t>(corrected_t);
         }
 
         /// teensy_t_to_t converts uint32 timestamps to uint64.
@@ -359,9 +1002,16 @@ namespace hibiscus {
         }
 
         HandleEvent _handle_event;
+        const teensy_dmd_mode _dmd_mode;
+        teensy_clock* _clock;
+        teensy_frames* _frames;
+        bool _extended_timestamps;
         uint32_t _previous_teensy_t;
         uint64_t _t_correction;
-        std::vector<buffered_event> _buffered_events;
+        uint64_t _dropped_frames;
+        uint32_t _next_frame_id;
+        std::vector<teensy_event> _uncorrected_events;
+        std::priority_queue<teensy_event, std::vector<teensy_event>, later> _buffered_events;
     };
 
     /// teensy_eventide_delegate is a delegate for the record firmware.
@@ -375,9 +1025,9 @@ namespace hibiscus {
         teensy_eventide_delegate& operator=(teensy_eventide_delegate&&) = default;
         virtual ~teensy_eventide_delegate() {}
         virtual void handle_start(teensy*, tty&) {}
-        virtual void handle_message(teensy*, const std::vector<uint8_t>& message) {
-            if (message.size() == 1) {
-                _handle_byte(message.front());
+        virtual void handle_message(teensy*, const teensy_message& message) {
+            if (message.size == 1) {
+                _handle_byte(message.type());
             }
         }
         virtual void handle_stop(teensy*, tty&) {}
@@ -386,23 +1036,476 @@ namespace hibiscus {
         HandleByte _handle_byte;
     };
 
+    /// teensy_event_queue handles Teensy events on a dedicated thread.
+    /// Events are pushed by the Teensy read loop, so that slow handlers do not delay the serial communication.
+    /// The handling thread sleeps on a condition variable when the queue is empty, and push only locks
+    /// the mutex to wake it up.
+    template <typename HandleEvent, typename HandleException>
+    class teensy_event_queue {
+        public:
+        teensy_event_queue(HandleEvent handle_event, HandleException handle_exception, std::size_t capacity) :
+            _handle_event(std::forward<HandleEvent>(handle_event)),
+            _handle_exception(std::forward<HandleException>(handle_exception)),
+            _running(true),
+            _waiting(false),
+            _events(capacity) {
+            _loop = std::thread([this]() {
+                try {
+                    teensy_event event;
+                    for (;;) {
+                        if (_events.pull(event)) {
+                            _handle_event(event);
+                            continue;
+                        }
+                        if (!_running.load(std::memory_order_acquire)) {
+                            if (!_events.pull(event)) {
+                                break;
+                            }
+                            _handle_event(event);
+                            continue;
+                        }
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _waiting.store(true, std::memory_order_relaxed);
+                        // pairs with the fence in push: either push sees _waiting, or pull sees the event
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if (_events.pull(event)) {
+                            _waiting.store(false, std::memory_order_relaxed);
+                            lock.unlock();
+                            _handle_event(event);
+                            continue;
+                        }
+                        _condition_variable.wait(lock, [this]() {
+                            return !_waiting.load(std::memory_order_relaxed)
+                                   || !_running.load(std::memory_order_acquire);
+                        });
+                        _waiting.store(false, std::memory_order_relaxed);
+                    }
+                } catch (...) {
+                    _handle_exception(std::current_exception());
+                }
+            });
+        }
+        teensy_event_queue(const teensy_event_queue&) = delete;
+        teensy_event_queue(teensy_event_queue&&) = default;
+        teensy_event_queue& operator=(const teensy_event_queue&) = delete;
+        teensy_event_queue& operator=(teensy_event_queue&&) = default;
+        virtual ~teensy_event_queue() {
+            _running.store(false, std::memory_order_release);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+            }
+            _condition_variable.notify_one();
+            _loop.join();
+        }
+
+        /// push forwards an event to the handling thread.
+        /// It must be called from a single thread, and returns false if the queue is full.
+        virtual bool push(teensy_event event) {
+            if (!_events.push(event)) {
+                return false;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_waiting.load(std::memory_order_relaxed)) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _waiting.store(false, std::memory_order_relaxed);
+                }
+                _condition_variable.notify_one();
+            }
+            return true;
+        }
+
+        /// overflows returns the number of dropped events.
+        virtual std::size_t overflows() const {
+            return _events.overflows();
+        }
+
+        /// high_water_mark returns the largest number of events waiting to be handled.
+        virtual std::size_t high_water_mark() const {
+            return _events.high_water_mark();
+        }
+
+        /// capacity returns the maximum number of events waiting to be handled.
+        virtual std::size_t capacity() const {
+            return _events.capacity();
+        }
+
+        protected:
+        HandleEvent _handle_event;
+        HandleException _handle_exception;
+        std::atomic_bool _running;
+        std::atomic_bool _waiting;
+        spsc_queue<teensy_event> _events;
+        std::mutex _mutex;
+        std::condition_variable _condition_variable;
+        std::thread _loop;
+    };
+
+    /// default_teensy_filename is the device path of a single Teensy board.
+    const std::string default_teensy_filename("/dev/ttyACM0");
+
+    /// teensy_filename returns the device path of a Teensy board given its path or its USB serial number.
+    /// Serial numbers are looked up in /dev/serial/by-id, which lists the devices by vendor, product and serial.
+    inline std::string teensy_filename(const std::string& path_or_serial) {
+        if (path_or_serial.find('/') != std::string::npos) {
+            return path_or_serial;
+        }
+        const std::string directory_name("/dev/serial/by-id");
+        auto directory = opendir(directory_name.c_str());
+        if (!directory) {
+            throw std::runtime_error(directory_name + " could not be open for reading");
+        }
+        std::string filename;
+        while (auto entry = readdir(directory)) {
+            const std::string name(entry->d_name);
+            if (name.find(std::string("_") + path_or_serial + "-") != std::string::npos) {
+                filename = directory_name + "/" + name;
+                break;
+            }
+        }
+        closedir(directory);
+        if (filename.empty()) {
+            throw std::runtime_error(
+                std::string("no Teensy with the serial number '") + path_or_serial + "' was found");
+        }
+        return filename;
+    }
+
     /// make_record_teensy creates a teensy from functors.
     template <typename HandleEvent, typename HandleException>
-    std::unique_ptr<specialized_teensy<teensy_record_delegate<HandleEvent>, HandleException>>
-    make_teensy_record(HandleEvent handle_event, HandleException handle_exception) {
+    std::unique_ptr<specialized_teensy<teensy_record_delegate<HandleEvent>, HandleException>> make_teensy_record(
+        HandleEvent handle_event,
+        HandleException handle_exception,
+        const std::string& filename = default_teensy_filename,
+        reactor* event_loop = nullptr,
+        teensy_dmd_mode dmd_mode = teensy_dmd_mode::subframes,
+        teensy_clock* clock = nullptr,
+        teensy_frames* frames = nullptr) {
         return std::unique_ptr<specialized_teensy<teensy_record_delegate<HandleEvent>, HandleException>>(
             new specialized_teensy<teensy_record_delegate<HandleEvent>, HandleException>(
-                teensy_record_delegate<HandleEvent>(std::forward<HandleEvent>(handle_event)),
-                std::forward<HandleException>(handle_exception)));
+                filename,
+                teensy_record_delegate<HandleEvent>(
+                    std::forward<HandleEvent>(handle_event), dmd_mode, clock, frames),
+                std::forward<HandleException>(handle_exception),
+                event_loop));
     }
 
     /// make_teensy_eventide is an interface to the teensy_eventide firmware.
     template <typename HandleByte, typename HandleException>
-    std::unique_ptr<specialized_teensy<teensy_eventide_delegate<HandleByte>, HandleException>>
-    make_teensy_eventide(HandleByte handle_byte, HandleException handle_exception) {
+    std::unique_ptr<specialized_teensy<teensy_eventide_delegate<HandleByte>, HandleException>> make_teensy_eventide(
+        HandleByte handle_byte,
+        HandleException handle_exception,
+        const std::string& filename = default_teensy_filename,
+        reactor* event_loop = nullptr) {
         return std::unique_ptr<specialized_teensy<teensy_eventide_delegate<HandleByte>, HandleException>>(
             new specialized_teensy<teensy_eventide_delegate<HandleByte>, HandleException>(
+                filename,
                 teensy_eventide_delegate<HandleByte>(std::forward<HandleByte>(handle_byte)),
-                std::forward<HandleException>(handle_exception)));
+                std::forward<HandleException>(handle_exception),
+                event_loop));
+    }
+
+    /// make_teensy_event_queue creates a teensy_event_queue from functors.
+    template <typename HandleEvent, typename HandleException>
+    std::unique_ptr<teensy_event_queue<HandleEvent, HandleException>>
+    make_teensy_event_queue(HandleEvent handle_event, HandleException handle_exception, std::size_t capacity) {
+        return std::unique_ptr<teensy_event_queue<HandleEvent, HandleException>>(
+            new teensy_event_queue<HandleEvent, HandleException>(
+                std::forward<HandleEvent>(handle_event), std::forward<HandleException>(handle_exception), capacity));
+    }
+
+    /// teensy_merge merges the events of several Teensy boards into a single stream ordered by timestamp.
+    /// The timestamps of the boards other than the first one are converted to the first board's clock,
+    /// using each board's model of its clock relative to the host clock.
+    /// An event is released once every board has flushed its events up to the event's timestamp,
+    /// hence the merged stream lags behind the boards by a flush period.
+    /// BNC echoes ('a' and 'b'), periodic sync edges ('s') and display ticks ('c') are not ordered by the boards,
+    /// and are released immediately.
+    template <typename HandleEvent>
+    class teensy_merge {
+        public:
+        /// merge_clock notifies the merge of the flush messages of one board.
+        class merge_clock : public teensy_clock {
+            public:
+            merge_clock(teensy_merge* merge, uint8_t device, teensy_clock* clock) :
+                teensy_clock(256),
+                _merge(merge),
+                _device(device),
+                _clock(clock) {}
+            merge_clock(const merge_clock&) = delete;
+            merge_clock(merge_clock&&) = delete;
+            merge_clock& operator=(const merge_clock&) = delete;
+            merge_clock& operator=(merge_clock&&) = delete;
+            virtual ~merge_clock() {}
+            virtual void add(uint64_t teensy_t, std::chrono::steady_clock::time_point host_t) override {
+                teensy_clock::add(teensy_t, host_t);
+                if (_clock) {
+                    _clock->add(teensy_t, host_t);
+                }
+                _merge->advance(_device, teensy_t);
+            }
+
+            protected:
+            teensy_merge* _merge;
+            const uint8_t _device;
+            teensy_clock* _clock;
+        };
+
+        teensy_merge(HandleEvent handle_event, std::size_t devices, teensy_clock* clock) :
+            _handle_event(std::forward<HandleEvent>(handle_event)),
+            _devices(devices),
+            _previous_t(0) {
+            if (devices == 0 || devices > std::numeric_limits<uint8_t>::max()) {
+                throw std::logic_error("the number of Teensy boards must be in the range [1, 255]");
+            }
+            for (std::size_t device = 0; device < devices; ++device) {
+                _clocks.emplace_back(
+                    new merge_clock(this, static_cast<uint8_t>(device), device == 0 ? clock : nullptr));
+                _devices[device].flushed = false;
+                _devices[device].previous_flush_t = 0;
+                _devices[device].watermark_ready = false;
+                _devices[device].watermark = 0;
+            }
+        }
+        teensy_merge(const teensy_merge&) = delete;
+        teensy_merge(teensy_merge&&) = delete;
+        teensy_merge& operator=(const teensy_merge&) = delete;
+        teensy_merge& operator=(teensy_merge&&) = delete;
+        virtual ~teensy_merge() {}
+
+        /// clock returns the model of the given board's clock, which must be passed to the board's delegate.
+        virtual teensy_clock* clock(std::size_t device) const {
+            return _clocks[device].get();
+        }
+
+        /// push handles an event from a board.
+        /// It can be called from several threads.
+        virtual void push(teensy_event event) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_devices.size() == 1) {
+                _handle_event(event);
+                return;
+            }
+            if (event.type == 'a' || event.type == 'b' || event.type == 's' || event.type == 'c') {
+                if (event.type != 'c' && aligned(event.device)) {
+                    event.t = align(event.device, event.t);
+                }
+                _handle_event(event);
+                return;
+            }
+            if (aligned(event.device)) {
+                event.t = align(event.device, event.t);
+                _events.push(event);
+                release();
+            } else {
+                _devices[event.device].unaligned_events.push_back(event);
+            }
+        }
+
+        /// advance is called by the boards' clocks when a flush message is received.
+        /// The delegate handles the events older than the flush after updating the clock,
+        /// hence only the previous flush bounds the events received so far.
+        virtual void advance(uint8_t device, uint64_t teensy_t) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto& current_device = _devices[device];
+            if (current_device.flushed) {
+                current_device.watermark_ready = aligned(device);
+                if (current_device.watermark_ready) {
+                    current_device.watermark = align(device, current_device.previous_flush_t);
+                }
+            }
+            current_device.flushed = true;
+            current_device.previous_flush_t = teensy_t;
+            release();
+        }
+
+        /// flush releases all the pending events.
+        virtual void flush() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (std::size_t device = 0; device < _devices.size(); ++device) {
+                for (auto event : _devices[device].unaligned_events) {
+                    if (aligned(event.device)) {
+                        event.t = align(event.device, event.t);
+                    }
+                    _events.push(event);
+                }
+                _devices[device].unaligned_events.clear();
+            }
+            while (!_events.empty()) {
+                handle_ordered_event(_events.top());
+                _events.pop();
+            }
+        }
+
+        protected:
+        /// device_state tracks the flushes and the pending events of a board.
+        struct device_state {
+            bool flushed;
+            uint64_t previous_flush_t;
+            bool watermark_ready;
+            uint64_t watermark;
+            std::vector<teensy_event> unaligned_events;
+        };
+
+        /// later compares events' timestamps to build a min heap.
+        struct later {
+            bool operator()(const teensy_event& first, const teensy_event& second) const {
+                return first.t > second.t;
+            }
+        };
+
+        /// aligned returns true if the given board's timestamps can be converted to the first board's clock.
+        bool aligned(uint8_t device) const {
+            return device == 0 || (_clocks[0]->ready() && _clocks[device]->ready());
+        }
+
+        /// align converts a board's timestamp to the first board's clock.
+        uint64_t align(uint8_t device, uint64_t t) const {
+            if (device == 0) {
+                return t;
+            }
+            return _clocks[0]->host_to_teensy(_clocks[device]->teensy_to_host(t));
+        }
+
+        /// release handles the events which precede every board's latest complete flush.
+        void release() {
+            for (auto& current_device : _devices) {
+                if (!current_device.watermark_ready) {
+                    return;
+                }
+            }
+            auto watermark = std::numeric_limits<uint64_t>::max();
+            for (std::size_t device = 0; device < _devices.size(); ++device) {
+                watermark = std::min(watermark, _devices[device].watermark);
+                for (auto event : _devices[device].unaligned_events) {
+                    event.t = align(event.device, event.t);
+                    _events.push(event);
+                }
+                _devices[device].unaligned_events.clear();
+            }
+            while (!_events.empty() && _events.top().t < watermark) {
+                handle_ordered_event(_events.top());
+                _events.pop();
+            }
+        }
+
+        /// handle_ordered_event forwards an event, and guarantees monotonic timestamps
+        /// despite the clock models' updates.
+        void handle_ordered_event(teensy_event event) {
+            if (event.t < _previous_t) {
+                event.t = _previous_t;
+            }
+            _previous_t = event.t;
+            _handle_event(event);
+        }
+
+        HandleEvent _handle_event;
+        std::mutex _mutex;
+        std::vector<std::unique_ptr<merge_clock>> _clocks;
+        std::vector<device_state> _devices;
+        std::priority_queue<teensy_event, std::vector<teensy_event>, later> _events;
+        uint64_t _previous_t;
+    };
+
+    /// teensy_group manages several Teensy boards running the record firmware.
+    /// The first board is the reference: the other boards' timestamps are converted to its clock.
+    class teensy_group {
+        public:
+        teensy_group() = default;
+        teensy_group(const teensy_group&) = delete;
+        teensy_group(teensy_group&&) = default;
+        teensy_group& operator=(const teensy_group&) = delete;
+        teensy_group& operator=(teensy_group&&) = default;
+        virtual ~teensy_group() {}
+
+        /// size returns the number of boards.
+        virtual std::size_t size() const {
+            return _teensys.size();
+        }
+
+        /// device returns the board with the given index, which can be used to send commands.
+        virtual teensy& device(std::size_t index) {
+            return *_teensys[index];
+        }
+
+        /// clock returns the model of the given board's clock relative to the host clock.
+        virtual const teensy_clock& clock(std::size_t index) const = 0;
+
+        protected:
+        std::vector<std::unique_ptr<teensy>> _teensys;
+    };
+
+    /// specialized_teensy_group merges the events of several boards, tagged with the index of their board.
+    template <typename HandleEvent, typename HandleException>
+    class specialized_teensy_group : public teensy_group {
+        public:
+        specialized_teensy_group(
+            const std::vector<std::string>& paths_or_serials,
+            HandleEvent handle_event,
+            HandleException handle_exception,
+            reactor* event_loop,
+            teensy_dmd_mode dmd_mode,
+            teensy_clock* clock,
+            teensy_frames* frames) :
+            teensy_group(),
+            _merge(std::forward<HandleEvent>(handle_event), paths_or_serials.size(), clock) {
+            try {
+                for (std::size_t index = 0; index < paths_or_serials.size(); ++index) {
+                    const auto device = static_cast<uint8_t>(index);
+                    _teensys.push_back(make_teensy_record(
+                        [this, device](teensy_event event) {
+                            event.device = device;
+                            _merge.push(event);
+                        },
+                        handle_exception,
+                        teensy_filename(paths_or_serials[index]),
+                        event_loop,
+                        dmd_mode,
+                        _merge.clock(index),
+                        index == 0 ? frames : nullptr));
+                }
+            } catch (...) {
+                _teensys.clear();
+                throw;
+            }
+        }
+        specialized_teensy_group(const specialized_teensy_group&) = delete;
+        specialized_teensy_group(specialized_teensy_group&&) = delete;
+        specialized_teensy_group& operator=(const specialized_teensy_group&) = delete;
+        specialized_teensy_group& operator=(specialized_teensy_group&&) = delete;
+        virtual ~specialized_teensy_group() {
+            _teensys.clear();
+            _merge.flush();
+        }
+        virtual const teensy_clock& clock(std::size_t index) const override {
+            return *_merge.clock(index);
+        }
+
+        protected:
+        teensy_merge<HandleEvent> _merge;
+    };
+
+    /// make_teensy_group creates a teensy_group from functors.
+    /// The boards are given by device path or USB serial number.
+    /// If clock is not null, it is also updated with the first board's flush messages.
+    /// If frames is not null, it receives the payloads of the first board's compact DMD frames.
+    template <typename HandleEvent, typename HandleException>
+    std::unique_ptr<specialized_teensy_group<HandleEvent, HandleException>> make_teensy_group(
+        const std::vector<std::string>& paths_or_serials,
+        HandleEvent handle_event,
+        HandleException handle_exception,
+        reactor* event_loop = nullptr,
+        teensy_dmd_mode dmd_mode = teensy_dmd_mode::subframes,
+        teensy_clock* clock = nullptr,
+        teensy_frames* frames = nullptr) {
+        return std::unique_ptr<specialized_teensy_group<HandleEvent, HandleException>>(
+            new specialized_teensy_group<HandleEvent, HandleException>(
+                paths_or_serials,
+                std::forward<HandleEvent>(handle_event),
+                std::forward<HandleException>(handle_exception),
+                event_loop,
+                dmd_mode,
+                clock,
+                frames));
     }
 }
@@ -0,0 +1,116 @@
+#include "livetrack_data_observable.hpp"
+#include <cstring>
+#include <iostream>
+#include <random>
+
+/// vector_path returns the name of the instruction set used by decode_livetrack_eye_fields.
+const char* vector_path() {
+#if defined(__SSSE3__)
+    return "SSSE3";
+#elif defined(__aarch64__)
+    return "NEON";
+#else
+    return "none (scalar fallback, compile with -mssse3 on x86)";
+#endif
+}
+
+/// decode_all decodes every report and returns a checksum, so that the decoding is not optimized away.
+template <hibiscus::livetrack_data (*Decode)(const uint8_t*)>
+uint64_t decode_all(const std::vector<uint8_t>& reports) {
+    uint64_t checksum = 0;
+    for (std::size_t offset = 0; offset < reports.size(); offset += hibiscus::livetrack_report_layout::size) {
+        const auto data = Decode(reports.data() + offset);
+        checksum += data.t + data.io + data.left.pupil_x + data.left.glint_2_y + data.right.major_axis
+                    + data.right.glint_2_y + data.left.has_glint_2 + data.right.enabled;
+    }
+    return checksum;
+}
+
+int main() {
+    try {
+        const auto report_size = hibiscus::livetrack_report_layout::size;
+        std::vector<uint8_t> reports;
+        auto append = [&](const std::array<uint8_t, hibiscus::livetrack_report_layout::size>& report) {
+            reports.insert(reports.end(), report.begin(), report.end());
+        };
+        std::array<uint8_t, hibiscus::livetrack_report_layout::size> report;
+
+        // edge cases: constant reports, every status combination, and single set bits
+        for (auto value : {0x00, 0xff, 0x55, 0xaa, 0x80, 0x01}) {
+            report.fill(static_cast<uint8_t>(value));
+            append(report);
+        }
+        for (auto fill : {0x00, 0xff}) {
+            for (uint32_t left_status = 0; left_status < 256; ++left_status) {
+                for (uint32_t right_status : {0x00, 0x0f, 0xf0, 0xff, 0x05, 0x0a}) {
+                    report.fill(static_cast<uint8_t>(fill));
+                    report[hibiscus::livetrack_report_layout::left_status] = static_cast<uint8_t>(left_status);
+                    report[hibiscus::livetrack_report_layout::right_status] = static_cast<uint8_t>(right_status);
+                    append(report);
+                }
+            }
+        }
+        for (std::size_t bit = 0; bit < report_size * 8; ++bit) {
+            report.fill(0x00);
+            report[bit / 8] = static_cast<uint8_t>(1 << (bit % 8));
+            append(report);
+            report.fill(0xff);
+            report[bit / 8] = static_cast<uint8_t>(~(1 << (bit % 8)));
+            append(report);
+        }
+        const auto edge_cases = reports.size() / report_size;
+
+        // random reports, with a fixed seed so that failures can be reproduced
+        std::mt19937 generator(42);
+        std::uniform_int_distribution<uint32_t> byte_distribution(0, 255);
+        const std::size_t random_reports = 1 << 18;
+        for (std::size_t index = 0; index < random_reports * report_size; ++index) {
+            reports.push_back(static_cast<uint8_t>(byte_distribution(generator)));
+        }
+
+        // bit-exactness
+        std::size_t mismatches = 0;
+        for (std::size_t offset = 0; offset < reports.size(); offset += report_size) {
+            const auto vector_data = hibiscus::report_to_livetrack_data(reports.data() + offset);
+            const auto scalar_data = hibiscus::report_to_livetrack_data_scalar(reports.data() + offset);
+            if (std::memcmp(&vector_data, &scalar_data, sizeof(hibiscus::livetrack_data)) != 0) {
+                if (mismatches < 8) {
+                    std::cout << "mismatch for report " << offset / report_size
+                              << (offset / report_size < edge_cases ? " (edge case)" : " (random)") << std::endl;
+                }
+                ++mismatches;
+            }
+        }
+        std::cout << "vector path: " << vector_path() << std::endl;
+        std::cout << edge_cases << " edge cases and " << random_reports << " random reports, " << mismatches
+                  << " mismatches" << std::endl;
+
+        // timing, the best of several rounds limits the influence of the scheduler
+        auto best_duration = [&](uint64_t (*decode)(const std::vector<uint8_t>&), uint64_t& checksum) {
+            auto result = std::chrono::steady_clock::duration::max();
+            for (std::size_t round = 0; round < 16; ++round) {
+                const auto begin = std::chrono::steady_clock::now();
+                checksum += decode(reports);
+                result = std::min(result, std::chrono::steady_clock::now() - begin);
+            }
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(result).count())
+                   / (reports.size() / report_size);
+        };
+        uint64_t vector_checksum = 0;
+        uint64_t scalar_checksum = 0;
+        const auto vector_duration =
+            best_duration(decode_all<hibiscus::report_to_livetrack_data>, vector_checksum);
+        const auto scalar_duration =
+            best_duration(decode_all<hibiscus::report_to_livetrack_data_scalar>, scalar_checksum);
+        std::cout << "vector: " << vector_duration << " ns per report, scalar: " << scalar_duration
+                  << " ns per report (checksums " << (vector_checksum == scalar_checksum ? "match" : "differ") << ")"
+                  << std::endl;
+        if (mismatches > 0 || vector_checksum != scalar_checksum) {
+            return 1;
+        }
+    } catch (const std::runtime_error& exception) {
+        std::cout << exception.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
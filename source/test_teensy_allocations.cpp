@@ -0,0 +1,168 @@
+#include "../third_party/hummingbird/third_party/pontella/source/pontella.hpp"
+#include "pty_teensy.hpp"
+#include "teensy.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+/// allocations counts the heap allocations of the threads which are not ignored.
+std::atomic<uint64_t> allocations(0);
+
+/// ignore_allocations is set by the threads which emulate the Teensy, since they are not part of the host path.
+thread_local bool ignore_allocations = false;
+
+void* operator new(std::size_t size) {
+    if (!ignore_allocations) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (auto pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "test_teensy_allocations plays back a Teensy byte log through the host decoder, and checks that",
+            "the steady-state path (decoding, delegate, event handler and teensy::send) does not allocate memory",
+            "Syntax: ./test_teensy_allocations [options] /path/to/log",
+            "The log is written by emulate_teensy --output. The first quarter of the events warms up the decoder.",
+            "Available options:",
+            "    -m [mode], --dmd-mode [mode]          sets the DMD protocol, one of:",
+            "                                              subframes, expanded or compact",
+            "                                              defaults to subframes",
+            "    -h, --help                            shows this help message",
+        },
+        argc,
+        argv,
+        1,
+        {{"dmd-mode", {"m"}}},
+        {},
+        [](pontella::command command) {
+            auto dmd_mode = hibiscus::teensy_dmd_mode::subframes;
+            {
+                const auto name_and_value = command.options.find("dmd-mode");
+                if (name_and_value != command.options.end()) {
+                    if (name_and_value->second == "expanded") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::expanded_frames;
+                    } else if (name_and_value->second == "compact") {
+                        dmd_mode = hibiscus::teensy_dmd_mode::compact_frames;
+                    } else if (name_and_value->second != "subframes") {
+                        throw std::runtime_error("the DMD mode must be 'subframes', 'expanded' or 'compact'");
+                    }
+                }
+            }
+            std::vector<uint8_t> log;
+            {
+                std::ifstream input(command.arguments.front(), std::ifstream::binary);
+                if (!input.good()) {
+                    throw std::runtime_error(
+                        std::string("'") + command.arguments.front() + "' could not be open for reading");
+                }
+                log.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+            }
+            // the events are counted by a first playback, so that the warm-up can be set to a quarter of them
+            uint64_t expected_events = 0;
+            for (auto pass : {0, 1}) {
+                std::atomic_bool running(true);
+                std::atomic_bool played_back(false);
+                std::exception_ptr playback_exception;
+                hibiscus::pty_teensy emulated_teensy;
+                std::thread playback_loop([&]() {
+                    ignore_allocations = true;
+                    try {
+                        emulated_teensy.replay(log, running);
+                    } catch (...) {
+                        playback_exception = std::current_exception();
+                    }
+                    played_back.store(true, std::memory_order_release);
+                });
+                std::exception_ptr teensy_exception;
+                std::atomic<uint64_t> events(0);
+                uint64_t warm_events = 0;
+                std::atomic<uint64_t> warm_allocations(0);
+                std::atomic_bool warm(false);
+                std::unique_ptr<hibiscus::teensy> teensy;
+                try {
+                    teensy = hibiscus::make_teensy_record(
+                        [&](hibiscus::teensy_event) {
+                            ++events;
+                            if (pass == 1 && events >= expected_events / 4 && !warm.load(std::memory_order_relaxed)) {
+                                warm_events = events;
+                                warm_allocations.store(allocations.load(std::memory_order_relaxed));
+                                warm.store(true, std::memory_order_release);
+                            }
+                        },
+                        [&](std::exception_ptr exception) {
+                            teensy_exception = exception;
+                            running.store(false, std::memory_order_release);
+                        },
+                        emulated_teensy.filename(),
+                        nullptr,
+                        dmd_mode);
+                } catch (...) {
+                    running.store(false, std::memory_order_release);
+                    playback_loop.join();
+                    throw;
+                }
+                // commands are sent during the measurement (a burst, then one per iteration),
+                // and consumed by the playback thread
+                uint64_t commands = 0;
+                while (running.load(std::memory_order_acquire) && !played_back.load(std::memory_order_acquire)) {
+                    if (warm.load(std::memory_order_acquire)) {
+                        const std::size_t burst = commands == 0 ? 256 : 1;
+                        for (std::size_t index = 0; index < burst; ++index) {
+                            if (teensy->send('f')) {
+                                ++commands;
+                            }
+                        }
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+                // the writing thread gets some time to write the queued commands,
+                // and the measurement stops before the teensy destructor, which is not part of the steady state
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                const auto steady_allocations = allocations.load(std::memory_order_relaxed);
+                const auto steady_events = events.load();
+                teensy.reset();
+                running.store(false, std::memory_order_release);
+                playback_loop.join();
+                if (playback_exception) {
+                    std::rethrow_exception(playback_exception);
+                }
+                if (teensy_exception) {
+                    std::rethrow_exception(teensy_exception);
+                }
+                if (pass == 0) {
+                    expected_events = events.load();
+                    if (expected_events < 4) {
+                        throw std::runtime_error("the log contains too few events");
+                    }
+                    continue;
+                }
+                if (!warm.load(std::memory_order_acquire)) {
+                    throw std::runtime_error("the second playback did not reach the warm-up event");
+                }
+                const auto steady_state_allocations = steady_allocations - warm_allocations.load();
+                std::cout << steady_events - warm_events << " events and " << commands
+                          << " commands after the warm-up, " << steady_state_allocations << " allocations" << std::endl;
+                if (steady_state_allocations > 0) {
+                    throw std::runtime_error("the steady-state Teensy path allocated memory");
+                }
+            }
+        });
+}
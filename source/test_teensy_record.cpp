@@ -0,0 +1,204 @@
+#include "pty_teensy.hpp"
+#include "teensy.hpp"
+#include <iostream>
+
+/// test_record_delegate skips the handshake of teensy_record_delegate, which requires a tty.
+template <typename HandleEvent>
+class test_record_delegate : public hibiscus::teensy_record_delegate<HandleEvent> {
+    public:
+    test_record_delegate(
+        HandleEvent handle_event,
+        hibiscus::teensy_dmd_mode dmd_mode,
+        bool extended_timestamps,
+        hibiscus::teensy_frames* frames) :
+        hibiscus::teensy_record_delegate<HandleEvent>(
+            std::forward<HandleEvent>(handle_event), dmd_mode, nullptr, frames) {
+        this->_extended_timestamps = extended_timestamps;
+    }
+};
+
+/// make_test_record_delegate creates a test delegate from a functor.
+template <typename HandleEvent>
+test_record_delegate<HandleEvent> make_test_record_delegate(
+    HandleEvent handle_event,
+    hibiscus::teensy_dmd_mode dmd_mode,
+    bool extended_timestamps,
+    hibiscus::teensy_frames* frames) {
+    return test_record_delegate<HandleEvent>(
+        std::forward<HandleEvent>(handle_event), dmd_mode, extended_timestamps, frames);
+}
+
+/// make_message encodes a timestamped message like the record firmware, followed by the given payload.
+/// The payload is truncated if the message exceeds teensy_message::capacity.
+hibiscus::teensy_message
+make_message(uint8_t type, uint64_t t, bool extended_timestamps, const std::vector<uint8_t>& payload) {
+    hibiscus::teensy_message message;
+    message.size = 0;
+    auto push = [&](uint8_t byte) {
+        if (message.size < message.bytes.size()) {
+            message.bytes[message.size] = byte;
+            ++message.size;
+        }
+    };
+    push(type);
+    for (uint8_t index = 0; index < (extended_timestamps ? 8 : 4); ++index) {
+        push(static_cast<uint8_t>((t >> (8 * index)) & 0xff));
+    }
+    for (auto byte : payload) {
+        push(byte);
+    }
+    return message;
+}
+
+/// make_frame_payload encodes a compact frame's period and deviations (offset by 128).
+std::vector<uint8_t> make_frame_payload(uint16_t period, std::size_t deviations) {
+    std::vector<uint8_t> payload{static_cast<uint8_t>(period & 0xff), static_cast<uint8_t>(period >> 8)};
+    for (std::size_t index = 0; index < deviations; ++index) {
+        payload.push_back(static_cast<uint8_t>(128 + static_cast<int32_t>(index % 7) - 3));
+    }
+    return payload;
+}
+
+int main() {
+    try {
+        std::size_t failures = 0;
+        auto check = [&](bool condition, const std::string& name) {
+            std::cout << (condition ? "pass: " : "fail: ") << name << std::endl;
+            if (!condition) {
+                ++failures;
+            }
+        };
+        for (auto extended_timestamps : {false, true}) {
+            const std::string suffix = extended_timestamps ? " (64-bit timestamps)" : " (32-bit timestamps)";
+            const std::size_t header_size = 3 + (extended_timestamps ? 8 : 4);
+            const auto maximum_deviations = hibiscus::teensy_message::capacity - header_size;
+            for (auto dmd_mode : {hibiscus::teensy_dmd_mode::compact_frames, hibiscus::teensy_dmd_mode::subframes}) {
+                const auto compact = dmd_mode == hibiscus::teensy_dmd_mode::compact_frames;
+                std::vector<hibiscus::teensy_event> events;
+                hibiscus::teensy_frames frames(16);
+                auto delegate = make_test_record_delegate(
+                    [&](hibiscus::teensy_event teensy_event) { events.push_back(teensy_event); },
+                    dmd_mode,
+                    extended_timestamps,
+                    &frames);
+
+                // a frame with teensy_event::deviations_capacity deviations is the largest valid frame
+                delegate.handle_message(
+                    nullptr,
+                    make_message(
+                        'g',
+                        1000,
+                        extended_timestamps,
+                        make_frame_payload(1389, hibiscus::teensy_frame::deviations_capacity)));
+                // every larger frame that fits in a message is dropped, as well as frames without a period
+                for (auto deviations = hibiscus::teensy_frame::deviations_capacity + 1;
+                     deviations <= maximum_deviations;
+                     ++deviations) {
+                    delegate.handle_message(
+                        nullptr,
+                        make_message('g', 2000, extended_timestamps, make_frame_payload(1389, deviations)));
+                }
+                delegate.handle_message(nullptr, make_message('g', 3000, extended_timestamps, {0x6d}));
+                delegate.handle_message(nullptr, make_message('f', 100000, extended_timestamps, {}));
+
+                const auto expected_dropped_frames =
+                    maximum_deviations - hibiscus::teensy_frame::deviations_capacity + 1;
+                check(
+                    delegate.dropped_frames() == expected_dropped_frames,
+                    std::string(compact ? "compact" : "subframes") + " mode counts "
+                        + std::to_string(expected_dropped_frames) + " dropped frames" + suffix);
+                if (compact) {
+                    hibiscus::teensy_frame frame;
+                    check(
+                        events.size() == 1 && events.front().type == 'g' && events.front().t == 1000
+                            && frames.pull(events.front().id, frame)
+                            && frame.subframes() == hibiscus::teensy_frame::deviations_capacity + 1
+                            && frame.period == 1389 && frame.deviations[0] == -3
+                            && frame.deviations[hibiscus::teensy_frame::deviations_capacity - 1]
+                                   == static_cast<int32_t>((hibiscus::teensy_frame::deviations_capacity - 1) % 7) - 3,
+                        std::string("compact mode keeps the largest valid frame") + suffix);
+                } else {
+                    auto expected_t = static_cast<uint64_t>(1000);
+                    auto valid = events.size() == hibiscus::teensy_frame::deviations_capacity + 1;
+                    for (std::size_t index = 0; valid && index < events.size(); ++index) {
+                        valid = events[index].type == (index == 0 ? 'd' : 'e') && events[index].t == expected_t;
+                        expected_t += 1389 + static_cast<int32_t>(index % 7) - 3;
+                    }
+                    check(valid, std::string("subframes mode expands the largest valid frame") + suffix);
+                }
+            }
+        }
+
+        // the frames of dropped 'g' events are skipped, and frames dropped by a full queue are reported
+        {
+            check(sizeof(hibiscus::teensy_event) <= 16, "teensy_event fits in 16 bytes");
+            hibiscus::teensy_frames frames(2);
+            hibiscus::teensy_frame frame;
+            frame.period = 1389;
+            frame.deviations_size = 0;
+            auto pushed = true;
+            for (uint32_t id = 0; id < 3; ++id) {
+                frame.id = id;
+                pushed = frames.push(frame);
+            }
+            check(!pushed && frames.overflows() == 1, "a full frames queue rejects frames");
+            check(frames.pull(1, frame) && frame.id == 1, "frames preceding the requested id are skipped");
+            check(!frames.pull(2, frame), "a frame rejected by the queue is reported as dropped");
+            frame.id = 3;
+            frames.push(frame);
+            check(frames.pull(3, frame) && frame.id == 3, "frames following a dropped frame are retrieved");
+        }
+
+        // a firmware without extended timestamps keeps sending messages while the host waits for the 'x' reply
+        {
+            hibiscus::pty_teensy emulated_teensy;
+            std::atomic_bool running(true);
+            std::thread firmware_loop([&]() {
+                while (running.load(std::memory_order_acquire)) {
+                    emulated_teensy.read(std::chrono::milliseconds(10), [&](const std::vector<uint8_t>& message) {
+                        if (message.size() == 1 && message[0] == 'r') {
+                            emulated_teensy.write({'r'});
+                            for (uint32_t index = 0; index < 8; ++index) {
+                                emulated_teensy.send('l', 1000 + index);
+                            }
+                            emulated_teensy.send('f', 2000);
+                            emulated_teensy.flush();
+                        }
+                    });
+                }
+            });
+            std::vector<hibiscus::teensy_event> events;
+            std::exception_ptr teensy_exception;
+            try {
+                hibiscus::make_teensy_record(
+                    [&](hibiscus::teensy_event teensy_event) { events.push_back(teensy_event); },
+                    [&](std::exception_ptr exception) { teensy_exception = exception; },
+                    emulated_teensy.filename());
+            } catch (...) {
+                running.store(false, std::memory_order_release);
+                firmware_loop.join();
+                throw;
+            }
+            running.store(false, std::memory_order_release);
+            firmware_loop.join();
+            if (teensy_exception) {
+                std::rethrow_exception(teensy_exception);
+            }
+            check(
+                std::count_if(
+                    events.begin(),
+                    events.end(),
+                    [](hibiscus::teensy_event teensy_event) { return teensy_event.type == 'l'; })
+                    == 8,
+                "messages sent during the extended timestamps request are handled");
+        }
+        if (failures > 0) {
+            std::cout << failures << " failed checks" << std::endl;
+            return 1;
+        }
+    } catch (const std::runtime_error& exception) {
+        std::cout << exception.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
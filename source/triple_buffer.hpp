@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/// hibiscus bundles tools to build a psychophysics platform on a Jetson TX1.
+namespace hibiscus {
+    /// triple_buffer hands the latest element over from a single producer thread to a single consumer thread.
+    /// The producer fills the back element and publishes it, and the consumer acquires the latest published element.
+    /// Neither thread waits for the other: an element published before the previous one was acquired replaces it.
+    template <typename Element>
+    class triple_buffer {
+        public:
+        triple_buffer(const Element& element = Element()) :
+            _elements{{element, element, element}},
+            _back(0),
+            _middle(1),
+            _front(2) {}
+        triple_buffer(const triple_buffer&) = delete;
+        triple_buffer(triple_buffer&&) = default;
+        triple_buffer& operator=(const triple_buffer&) = delete;
+        triple_buffer& operator=(triple_buffer&&) = default;
+        virtual ~triple_buffer() {}
+
+        /// back returns the element being filled by the producer.
+        /// It must only be called by the producer thread.
+        Element& back() {
+            return _elements[_back];
+        }
+
+        /// publish makes the back element available to the consumer, and returns false if it replaced
+        /// a published element which was never acquired.
+        /// It must only be called by the producer thread.
+        bool publish() {
+            const auto previous_middle =
+                _middle.exchange(static_cast<uint8_t>(_back | fresh), std::memory_order_acq_rel);
+            _back = static_cast<uint8_t>(previous_middle & index_mask);
+            return (previous_middle & fresh) == 0;
+        }
+
+        /// has_new returns true if an element was published since the last acquire.
+        bool has_new() const {
+            return (_middle.load(std::memory_order_acquire) & fresh) != 0;
+        }
+
+        /// acquire makes the latest published element the front element, and returns false if there is none.
+        /// It must only be called by the consumer thread.
+        bool acquire() {
+            if (!has_new()) {
+                return false;
+            }
+            _front = static_cast<uint8_t>(_middle.exchange(_front, std::memory_order_acq_rel) & index_mask);
+            return true;
+        }
+
+        /// front returns the element being read by the consumer.
+        /// It must only be called by the consumer thread.
+        Element& front() {
+            return _elements[_front];
+        }
+
+        protected:
+        /// index_mask extracts the element index from the middle state.
+        static constexpr uint8_t index_mask = 3;
+
+        /// fresh flags a published element which was not acquired yet.
+        static constexpr uint8_t fresh = 4;
+
+        std::array<Element, 3> _elements;
+        uint8_t _back;
+        std::atomic<uint8_t> _middle;
+        uint8_t _front;
+    };
+}
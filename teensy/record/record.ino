@@ -6,6 +6,10 @@ const byte jetson_up_pin = 28;
 const byte jetson_switch_on_pin = 29;
 const byte led_pin = 13;
 const uint32_t tick_half_period = 8333;
+const uint32_t subframe_period = 1030;
+const uint32_t subframe_tolerance = 100;
+const uint8_t frame_capacity = 32;
+const int32_t deviation_offset = 128;
 
 /// input represents a signal to watch and timestamp.
 struct input {
@@ -149,15 +153,73 @@ void write(const byte* message, const uint32_t size, const bool flush) {
     }
 }
 
-/// send generates and writes a message.
-void send(const byte type, const uint32_t t, const bool flush) {
+/// send_value generates and writes a message with a 32-bit payload.
+void send_value(const byte type, const uint32_t value, const bool flush) {
     byte message[5] = {
-        type, (byte)(t & 0xff), (byte)((t >> 8) & 0xff), (byte)((t >> 16) & 0xff), (byte)((t >> 24) & 0xff)};
+        type,
+        (byte)(value & 0xff),
+        (byte)((value >> 8) & 0xff),
+        (byte)((value >> 16) & 0xff),
+        (byte)((value >> 24) & 0xff)};
     write(message, sizeof(message), flush);
 }
 
+/// clock variables
+/// epoch counts the micros() overflows, so that timestamps can be extended to 64 bits.
+uint32_t epoch = 0;
+uint32_t clock_micros = 0;
+bool extended_timestamps = false;
+
+/// update_clock must be called at least once per micros() overflow period (about 71 minutes).
+void update_clock(const uint32_t t) {
+    if (t < clock_micros) {
+        ++epoch;
+    }
+    clock_micros = t;
+}
+
+/// extend converts a recent 32-bit timestamp to 64 bits.
+/// t must be within 35 minutes of the last update_clock call.
+uint64_t extend(const uint32_t t) {
+    return (((uint64_t)epoch << 32) | clock_micros) + (int64_t)((int32_t)(t - clock_micros));
+}
+
+/// write_t encodes a timestamp with 4 bytes, or 8 bytes if extended timestamps are enabled.
+/// It returns the number of bytes written.
+uint8_t write_t(byte* bytes, const uint32_t t) {
+    const uint64_t extended_t = extended_timestamps ? extend(t) : t;
+    const uint8_t size = extended_timestamps ? 8 : 4;
+    for (uint8_t index = 0; index < size; ++index) {
+        bytes[index] = (byte)((extended_t >> (8 * index)) & 0xff);
+    }
+    return size;
+}
+
+/// send generates and writes a timestamped message.
+void send(const byte type, const uint32_t t, const bool flush) {
+    byte message[9];
+    message[0] = type;
+    write(message, 1 + write_t(message + 1, t), flush);
+}
+
+/// send_sync writes a periodic sync edge message, with the edge index following the timestamp.
+void send_sync(const uint32_t t, const uint32_t id) {
+    byte message[13];
+    message[0] = 's';
+    const uint8_t size = 1 + write_t(message + 1, t);
+    for (uint8_t index = 0; index < 4; ++index) {
+        message[size + index] = (byte)((id >> (8 * index)) & 0xff);
+    }
+    write(message, size + 4, true);
+}
+
 /// state variables
-byte read_message[1];
+byte frame_message[11 + frame_capacity];
+uint8_t frame_size = 0;
+uint8_t frame_limit = 0;
+bool compact_frames = false;
+bool flush_pending = false;
+byte read_message[5];
 read_state state = {read_message, sizeof(read_message), 0, false, false};
 uint32_t previous_d_t = 0;
 bool frame_boundary = false;
@@ -168,6 +230,29 @@ uint32_t previous_flush_t = 0;
 uint32_t computer_tick = 0;
 bool pinged = false;
 bool send_fake_event = false;
+uint32_t sync_half_period = 0;
+uint32_t sync_t = 0;
+uint32_t sync_id = 0;
+
+/// open_frame starts a compact frame message ('g').
+/// The message contains the frame timestamp, the nominal subframe period and the signed deviation from this period
+/// of each subsequent subframe interval, offset by deviation_offset so that null deviations need no escaping.
+void open_frame(const uint32_t t) {
+    frame_message[0] = 'g';
+    frame_size = 1 + write_t(frame_message + 1, t);
+    frame_message[frame_size] = (byte)(subframe_period & 0xff);
+    frame_message[frame_size + 1] = (byte)((subframe_period >> 8) & 0xff);
+    frame_size += 2;
+    frame_limit = frame_size + frame_capacity;
+}
+
+/// close_frame writes the current compact frame message, if any.
+void close_frame() {
+    if (frame_size > 0) {
+        write(frame_message, frame_size, false);
+        frame_size = 0;
+    }
+}
 
 void setup() {
     // setup pins
@@ -207,27 +292,44 @@ void setup() {
 
 void loop() {
     const volatile uint32_t loop_t = micros();
+    update_clock(loop_t);
     {
-        bool has_message = false;
         for (unsigned int index = 0; index < sizeof(inputs) / sizeof(input); ++index) {
             const uint8_t local_head = inputs[index].head;
             while (inputs[index].tail != local_head) {
-                has_message = true;
+                // compact frames rely on the periodic flush, since a flush per frame would double their size
+                if (!compact_frames || inputs[index].id != 'd') {
+                    flush_pending = true;
+                }
                 const uint32_t local_t = inputs[index].ts[inputs[index].tail];
                 if (inputs[index].id == 'd') {
                     const uint32_t delta_t = local_t - previous_d_t;
-                    if (delta_t > 1030 - 100 && delta_t < 1030 + 100) {
-                        send('e', local_t, false);
+                    if (delta_t > subframe_period - subframe_tolerance
+                        && delta_t < subframe_period + subframe_tolerance) {
+                        if (frame_size > 0 && frame_size < frame_limit) {
+                            frame_message[frame_size] = (byte)(deviation_offset + (int32_t)delta_t - (int32_t)subframe_period);
+                            ++frame_size;
+                        } else {
+                            close_frame();
+                            send('e', local_t, false);
+                            flush_pending = true;
+                        }
                         frame_boundary = true;
                     } else {
+                        close_frame();
                         if (frame_boundary) {
-                            send('d', local_t, false);
+                            if (compact_frames) {
+                                open_frame(local_t);
+                            } else {
+                                send('d', local_t, false);
+                            }
                             frame_boundary = false;
                             tick_t = local_t;
                             ticked = true;
                             ++tick;
                         } else {
                             send('e', local_t, false);
+                            flush_pending = true;
                         }
                     }
                     previous_d_t = local_t;
@@ -241,13 +343,30 @@ void loop() {
             send_fake_event = false;
             send(loop_t % 2 == 0 ? 'l' : 'r', loop_t, false);
         }
-        if (has_message || loop_t - previous_flush_t > 100000) {
+        // no subframe can follow once the tolerance window has elapsed, hence the frame is complete
+        if (frame_size > 0 && micros() - previous_d_t > subframe_period + subframe_tolerance) {
+            close_frame();
+        }
+        // flushes are delayed while a frame is open, since the frame's subframes precede them
+        if (frame_size == 0 && (flush_pending || loop_t - previous_flush_t > 100000)) {
             send('f', loop_t, true);
             previous_flush_t = loop_t;
+            flush_pending = false;
+        }
+    }
+    // the BNC output toggles every sync half period, odd edges are rising
+    if (sync_half_period > 0 && micros() - sync_t >= sync_half_period) {
+        ++sync_id;
+        digitalWrite(bnc_pin, (sync_id & 1) ? HIGH : LOW);
+        const uint32_t now = micros();
+        send_sync(now, sync_id);
+        sync_t += sync_half_period;
+        if (now - sync_t >= sync_half_period) {
+            sync_t = now;
         }
     }
     if (ticked && (micros() - tick_t > tick_half_period)) {
-        send('c', tick, true);
+        send_value('c', tick, true);
         ticked = false;
     }
     if (read(&state)) {
@@ -262,6 +381,8 @@ void loop() {
                 }
                 case 'r': {
                     digitalWrite(bnc_pin, LOW);
+                    sync_half_period = 0;
+                    sync_id = 0;
                     previous_d_t = 0;
                     tick = 0;
                     tick_t = 0;
@@ -269,6 +390,10 @@ void loop() {
                     previous_flush_t = 0;
                     computer_tick = 0;
                     pinged = false;
+                    frame_size = 0;
+                    compact_frames = false;
+                    extended_timestamps = false;
+                    flush_pending = false;
                     noInterrupts();
                     for (unsigned int index = 0; index < sizeof(inputs) / sizeof(input); ++index) {
                         inputs[index].tail = inputs[index].head;
@@ -282,9 +407,26 @@ void loop() {
                     send_fake_event = true;
                     break;
                 }
+                case 'p': {
+                    compact_frames = true;
+                    break;
+                }
+                case 'x': {
+                    extended_timestamps = true;
+                    byte message[1] = {'x'};
+                    write(message, sizeof(message), true);
+                    break;
+                }
                 default:
                     break;
             }
+        } else if (state.index == 5 && state.message[0] == 's') {
+            // 's' starts a square wave on the BNC output with the given half period (0 stops it)
+            digitalWrite(bnc_pin, LOW);
+            sync_half_period = (uint32_t)state.message[1] | ((uint32_t)state.message[2] << 8)
+                               | ((uint32_t)state.message[3] << 16) | ((uint32_t)state.message[4] << 24);
+            sync_id = 0;
+            sync_t = micros();
         }
     }
 }
@@ -726,6 +726,11 @@ int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
     return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
+int HID_API_EXPORT hid_get_file_descriptor(hid_device *dev)
+{
+    return dev->device_handle;
+}
+
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 {
     /* Do all non-blocking in userspace using poll(), since it looks
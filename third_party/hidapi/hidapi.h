@@ -383,6 +383,21 @@ extern "C" {
         */
         HID_API_EXPORT const wchar_t* HID_API_CALL hid_error(hid_device *device);
 
+        /** @brief Get the file descriptor backing a device.
+
+            The descriptor becomes readable when an input report is
+            available, hence it can be monitored with poll() or epoll().
+            It must not be read from or closed directly.
+
+            @ingroup API
+            @param device A device handle returned from hid_open().
+
+            @returns
+                This function returns the file descriptor on success
+                and -1 on error.
+        */
+        int HID_API_EXPORT HID_API_CALL hid_get_file_descriptor(hid_device *device);
+
 #ifdef __cplusplus
 }
 #endif